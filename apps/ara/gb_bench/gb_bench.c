@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2015 Google Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <nuttx/greybus/greybus.h>
+#include <nuttx/greybus/local.h>
+#include <nuttx/greybus/loopback.h>
+
+#include <arch/byteorder.h>
+
+#define GB_BENCH_DEFAULT_CPORT      1
+#define GB_BENCH_DEFAULT_COUNT      1000
+#define GB_BENCH_DEFAULT_SIZE       64
+#define GB_BENCH_MAX_SIZE           1024
+#define GB_BENCH_TIMEOUT_SEC        1
+
+extern void gb_loopback_register(int cport, int bundle);
+
+struct gb_bench {
+    sem_t done;
+    uint16_t id;
+    uint8_t result;
+};
+
+static struct gb_bench gb_bench;
+static int gb_bench_cport = -1;
+
+static void gb_bench_peer_rx(unsigned int cport, const void *data,
+                             size_t size)
+{
+    const struct gb_operation_hdr *hdr = data;
+
+    if (size < sizeof(*hdr) || !(hdr->type & GB_TYPE_RESPONSE_FLAG))
+        return;
+
+    if (le16_to_cpu(hdr->id) != gb_bench.id)
+        return;
+
+    gb_bench.result = hdr->result;
+    sem_post(&gb_bench.done);
+}
+
+static int gb_bench_setup(int cport)
+{
+    int retval;
+
+    if (gb_bench_cport >= 0) {
+        if (gb_bench_cport != cport) {
+            fprintf(stderr, "gb_bench: already running on cport %d\n",
+                    gb_bench_cport);
+            return -EBUSY;
+        }
+        return 0;
+    }
+
+    sem_init(&gb_bench.done, 0, 0);
+
+    retval = gb_local_init(cport, gb_bench_peer_rx);
+    if (retval) {
+        fprintf(stderr, "gb_bench: cannot use cport %d: %d\n", cport,
+                retval);
+        return retval;
+    }
+
+    gb_loopback_register(cport, 0);
+
+    retval = gb_listen(cport);
+    if (retval) {
+        fprintf(stderr, "gb_bench: cannot listen on cport %d: %d\n", cport,
+                retval);
+        return retval;
+    }
+
+    gb_bench_cport = cport;
+    return 0;
+}
+
+static uint32_t gb_bench_elapsed_usec(const struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000000 +
+           (now.tv_nsec - start->tv_nsec) / 1000;
+}
+
+static int gb_bench_run_one(int cport, uint8_t *buf, uint8_t type,
+                            size_t size, uint32_t *latency)
+{
+    struct gb_operation_hdr *hdr = (struct gb_operation_hdr *) buf;
+    struct timespec start;
+    struct timespec timeout;
+    int retval;
+
+    if (++gb_bench.id == 0)
+        gb_bench.id = 1; /* ID 0 is for request with no response */
+
+    hdr->size = cpu_to_le16(sizeof(*hdr) + size);
+    hdr->id = cpu_to_le16(gb_bench.id);
+    hdr->type = type;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    retval = gb_local_inject(cport, buf, sizeof(*hdr) + size);
+    if (retval)
+        return retval;
+
+    clock_gettime(CLOCK_REALTIME, &timeout);
+    timeout.tv_sec += GB_BENCH_TIMEOUT_SEC;
+
+    while (sem_timedwait(&gb_bench.done, &timeout)) {
+        if (errno != EINTR)
+            return -errno;
+    }
+
+    *latency = gb_bench_elapsed_usec(&start);
+
+    return gb_bench.result ? -EIO : 0;
+}
+
+static int gb_bench_compare(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *) a;
+    uint32_t y = *(const uint32_t *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void show_usage(const char *appname)
+{
+    printf("%s [-c cport] [-n count] [-s size] [-t type]\n", appname);
+    printf("\t-c: loopback cport (default %d)\n", GB_BENCH_DEFAULT_CPORT);
+    printf("\t-n: number of operations (default %d)\n",
+           GB_BENCH_DEFAULT_COUNT);
+    printf("\t-s: payload size in bytes (default %d, max %d)\n",
+           GB_BENCH_DEFAULT_SIZE, GB_BENCH_MAX_SIZE);
+    printf("\t-t: ping, transfer or sink (default transfer)\n");
+}
+
+#ifdef CONFIG_BUILD_KERNEL
+int main(int argc, FAR char *argv[])
+#else
+int gb_bench_main(int argc, char *argv[])
+#endif
+{
+    struct gb_loopback_transfer_request *req;
+    struct gb_local_stats stats_start;
+    struct gb_local_stats stats_end;
+    struct timespec start;
+    uint32_t *latencies;
+    uint32_t elapsed;
+    uint8_t *buf;
+    uint8_t type = GB_LOOPBACK_TYPE_TRANSFER;
+    size_t payload;
+    int cport = GB_BENCH_DEFAULT_CPORT;
+    int count = GB_BENCH_DEFAULT_COUNT;
+    int size = GB_BENCH_DEFAULT_SIZE;
+    int retval = 0;
+    int c;
+    int i;
+
+    optind = -1;
+    while ((c = getopt(argc, argv, "c:n:s:t:")) != -1) {
+        switch (c) {
+        case 'c':
+            cport = atoi(optarg);
+            break;
+
+        case 'n':
+            count = atoi(optarg);
+            break;
+
+        case 's':
+            size = atoi(optarg);
+            break;
+
+        case 't':
+            if (!strcmp(optarg, "ping")) {
+                type = GB_LOOPBACK_TYPE_PING;
+            } else if (!strcmp(optarg, "transfer")) {
+                type = GB_LOOPBACK_TYPE_TRANSFER;
+            } else if (!strcmp(optarg, "sink")) {
+                type = GB_LOOPBACK_TYPE_SINK;
+            } else {
+                show_usage(argv[0]);
+                return -EINVAL;
+            }
+            break;
+
+        default:
+            show_usage(argv[0]);
+            return -EINVAL;
+        }
+    }
+
+    if (cport < 0 || count <= 0 || size < 0 || size > GB_BENCH_MAX_SIZE) {
+        show_usage(argv[0]);
+        return -EINVAL;
+    }
+
+    retval = gb_bench_setup(cport);
+    if (retval)
+        return retval;
+
+    payload = type == GB_LOOPBACK_TYPE_PING ? 0 : sizeof(*req) + size;
+
+    buf = zalloc(sizeof(struct gb_operation_hdr) + payload);
+    latencies = malloc(count * sizeof(*latencies));
+    if (!buf || !latencies) {
+        retval = -ENOMEM;
+        goto out;
+    }
+
+    if (payload) {
+        req = (struct gb_loopback_transfer_request *)
+            (buf + sizeof(struct gb_operation_hdr));
+        req->len = cpu_to_le32(size);
+        memset(req->data, 0xa5, size);
+    }
+
+    gb_local_get_stats(&stats_start);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (i = 0; i < count; i++) {
+        retval = gb_bench_run_one(cport, buf, type, payload, &latencies[i]);
+        if (retval) {
+            fprintf(stderr, "gb_bench: operation %d failed: %d\n", i, retval);
+            goto out;
+        }
+    }
+
+    elapsed = gb_bench_elapsed_usec(&start);
+    gb_local_get_stats(&stats_end);
+
+    qsort(latencies, count, sizeof(*latencies), gb_bench_compare);
+
+    printf("operations:      %d\n", count);
+    printf("elapsed:         %u us\n", elapsed);
+    printf("ops/sec:         %u\n",
+           elapsed ? (uint32_t) ((uint64_t) count * 1000000 / elapsed) : 0);
+    printf("latency p50:     %u us\n", latencies[count / 2]);
+    printf("latency p99:     %u us\n", latencies[(count * 99) / 100]);
+    printf("latency max:     %u us\n", latencies[count - 1]);
+    printf("allocs/op:       %u.%02u\n",
+           (stats_end.alloc_count - stats_start.alloc_count) / count,
+           ((stats_end.alloc_count - stats_start.alloc_count) % count) * 100 /
+           count);
+
+out:
+    free(latencies);
+    free(buf);
+    return retval;
+}
@@ -35,6 +35,7 @@
 #include <sys/time.h>
 
 #include <nuttx/arch.h>
+#include <nuttx/greybus/greybus.h>
 #include <nuttx/greybus/loopback.h>
 #include <nuttx/util.h>
 #include <nuttx/time.h>
@@ -296,6 +297,7 @@ int gb_loopback_service(void)
 
 static void print_status_normal(void)
 {
+    struct gb_operation_pool_stats pool_stats;
     struct gb_loopback_statistics stats;
     struct loopback_context *ctx;
     struct list_head *iter;
@@ -303,13 +305,13 @@ static void print_status_normal(void)
     loopback_ctx_list_lock();
     if (loopback_running_late)
         printf("  Running late\n  %d\n", loopback_running_late);
-    printf("  CPORT    ACTIVE    RECV ERR    SEND ERR    SENT    RECV    THROUGHPUT   LATENCY   REQ_PER_SEC\n");
+    printf("  CPORT    ACTIVE    RECV ERR    SEND ERR    SENT    RECV    THROUGHPUT   LATENCY       P50       P99   REQ_PER_SEC\n");
     list_foreach(&loopback_ctx_list, iter) {
         ctx = list_entry(iter, struct loopback_context, list);
 
         loopback_ctx_lock(ctx);
         gb_loopback_get_stats(ctx->cport, &stats);
-        printf("%7d %9s %11d %11d %7u %7u %13u %9u %13u\n",
+        printf("%7d %9s %11d %11d %7u %7u %13u %9u %9u %9u %13u\n",
                ctx->cport,
                ctx->active ? "yes" : "no",
                stats.recv_err,
@@ -318,10 +320,18 @@ static void print_status_normal(void)
                stats.recv,
                stats.throughput_avg,
                stats.latency_avg,
+               stats.latency_p50,
+               stats.latency_p99,
                stats.reqs_per_sec_avg);
         loopback_ctx_unlock(ctx);
     }
     loopback_ctx_list_unlock();
+
+    if (!gb_operation_get_pool_stats(&pool_stats))
+        printf("  Operation pool\n"
+               "  %u/%u in use, high water %u, %u fallbacks\n",
+               pool_stats.in_use, pool_stats.size, pool_stats.high_water,
+               pool_stats.fallbacks);
 }
 
 static void print_status_csv(void)
@@ -331,14 +341,14 @@ static void print_status_csv(void)
     struct list_head *iter;
 
     printf("; generated by gbl\n");
-    printf("; iterations, errors, requests per second (min, max, avg, jitter), latency (min, max, avg, jitter), throughput (min, max, avg, jitter)\n");
+    printf("; iterations, errors, requests per second (min, max, avg, jitter), latency (min, max, avg, jitter), throughput (min, max, avg, jitter), latency percentiles (p50, p90, p99, p99.9)\n");
     loopback_ctx_list_lock();
     list_foreach(&loopback_ctx_list, iter) {
         ctx = list_entry(iter, struct loopback_context, list);
 
         loopback_ctx_lock(ctx);
         gb_loopback_get_stats(ctx->cport, &stats);
-        printf("%d,%d,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u\n",
+        printf("%d,%d,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u\n",
                stats.recv,
                stats.recv_err,
                stats.reqs_per_sec_min,
@@ -352,7 +362,11 @@ static void print_status_csv(void)
                stats.throughput_min,
                stats.throughput_max,
                stats.throughput_avg,
-               stats.throughput_max - stats.throughput_min);
+               stats.throughput_max - stats.throughput_min,
+               stats.latency_p50,
+               stats.latency_p90,
+               stats.latency_p99,
+               stats.latency_p999);
         loopback_ctx_unlock(ctx);
     }
     loopback_ctx_list_unlock();
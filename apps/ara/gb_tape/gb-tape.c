@@ -36,10 +36,11 @@
 
 static void show_usage(const char *appname)
 {
-    printf("%s [-r filepath] [-p filepath]\n", appname);
+    printf("%s [-r filepath] [-s] [-p filepath] [-P filepath]\n", appname);
     printf("\t-r: tape greybus communication into 'filepath'\n");
     printf("\t-s: stop current taping\n");
-    printf("\t-p: replay greybus tape from 'filepath'\n");
+    printf("\t-p: replay greybus tape from 'filepath' as fast as possible\n");
+    printf("\t-P: replay greybus tape from 'filepath' with original timing\n");
 }
 
 #ifdef CONFIG_BUILD_KERNEL
@@ -60,7 +61,7 @@ int gb_tape_main(int argc, char *argv[])
 
     gb_tape_arm_semihosting_register();
 
-    while ((c = getopt(argc, argv, "r:p:s")) != -1) {
+    while ((c = getopt(argc, argv, "r:p:P:s")) != -1) {
         switch (c) {
         case 'r':
             retval = gb_tape_communication(optarg);
@@ -75,11 +76,16 @@ int gb_tape_main(int argc, char *argv[])
             if (retval) {
                 fprintf(stderr, "gb_tape: stop taping error: %s\n",
                         strerror(retval));
+            } else if (gb_tape_get_dropped_count()) {
+                printf("gb_tape: %u records dropped\n",
+                       gb_tape_get_dropped_count());
             }
             break;
 
         case 'p':
-            retval = gb_tape_replay(optarg);
+        case 'P':
+            retval = gb_tape_replay(optarg, c == 'P' ? GB_TAPE_REPLAY_PACED :
+                                                      GB_TAPE_REPLAY_FAST);
             if (retval) {
                 fprintf(stderr, "gb_tape: tape replay error: %s\n",
                         strerror(retval));
@@ -700,6 +700,10 @@ static void dump_regs(void) {
 void unipro_info(void)
 {
     dump_regs();
+
+    if (tx_calltable && tx_calltable->info) {
+        tx_calltable->info();
+    }
 }
 
 void unipro_switch_rxbuf(unsigned int cportid, void *buffer)
@@ -768,6 +772,7 @@ void unipro_init(void)
         cport->tx_buf = CPORT_TX_BUF(i);
         cport->cportid = i;
         list_init(&cport->tx_fifo);
+        list_init(&cport->tx_ready);
 
         _unipro_reset_cport(i);
     }
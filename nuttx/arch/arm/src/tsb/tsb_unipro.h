@@ -61,6 +61,7 @@ struct cport {
     bool switch_buf_on_free;
 
     struct list_head tx_fifo;
+    struct list_head tx_ready;      // DMA TX: entry in the ready CPort queue
 };
 
 struct unipro_tx_calltable {
@@ -68,6 +69,7 @@ struct unipro_tx_calltable {
     int  (*send)(unsigned int cportid, const void *buf, size_t len);
     int  (*send_async)(unsigned int cportid, const void *buf, size_t len,
                        unipro_send_completion_t callback, void *priv);
+    void (*info)(void);
 };
 
 struct cport *cport_handle(unsigned int cportid);
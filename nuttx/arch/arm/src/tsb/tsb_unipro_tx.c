@@ -29,6 +29,7 @@
 #include <errno.h>
 #include <pthread.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <nuttx/util.h>
 #include <nuttx/irq.h>
@@ -40,9 +41,22 @@
 #include "up_arch.h"
 #include "tsb_unipro.h"
 
+#ifndef CONFIG_ARCH_UNIPROTX_MEMCPY_QUANTUM
+#define CONFIG_ARCH_UNIPROTX_MEMCPY_QUANTUM 1
+#endif
+
+#ifndef CONFIG_ARCH_UNIPROTX_MEMCPY_BACKOFF_US
+#define CONFIG_ARCH_UNIPROTX_MEMCPY_BACKOFF_US 100
+#endif
+
+#define UNIPRO_TX_READY_WORDS \
+    ((CONFIG_ARCH_UNIPRO_MAX_CPORT_COUNT + 31) / 32)
+
 struct worker {
     pthread_t thread;
     sem_t tx_fifo_lock;
+    uint32_t ready[UNIPRO_TX_READY_WORDS]; /* CPorts with pending TX work */
+    unsigned int next_cport;
 };
 
 static struct worker worker;
@@ -116,15 +130,77 @@ reset:
 }
 
 
+/**
+ * @brief           Flag a CPort as having TX work for the worker
+ * @param[in]       cportid: CPort ID
+ */
+static void unipro_tx_set_ready(unsigned int cportid)
+{
+    irqstate_t flags;
+
+    flags = irqsave();
+    worker.ready[cportid / 32] |= BIT(cportid % 32);
+    irqrestore(flags);
+}
+
+/**
+ * @brief           Clear the ready flag of a CPort once it has no TX work left
+ * @param[in]       cport: CPort handle
+ */
+static void unipro_tx_clear_ready(struct cport *cport)
+{
+    irqstate_t flags;
+
+    flags = irqsave();
+    if (list_is_empty(&cport->tx_fifo) && !cport->pending_reset) {
+        worker.ready[cport->cportid / 32] &= ~BIT(cport->cportid % 32);
+    }
+    irqrestore(flags);
+}
+
+/**
+ * @brief           Find the next CPort with TX work
+ * @return          CPort ID, or -1 if no CPort has TX work
+ * @param[in]       from: CPort ID to start looking from, wrapping around
+ */
+static int unipro_tx_next_ready(unsigned int from)
+{
+    unsigned int cport_count = unipro_cport_count();
+    unsigned int cportid;
+    uint32_t mask;
+    int i;
+
+    for (cportid = from, i = 0; i < UNIPRO_TX_READY_WORDS + 1; i++) {
+        if (cportid >= cport_count) {
+            cportid = 0;
+        }
+
+        /* ready bits of the current word, starting at cportid */
+        mask = worker.ready[cportid / 32] & ~(BIT(cportid % 32) - 1);
+        if (mask) {
+            cportid = (cportid & ~31) + __builtin_ffs(mask) - 1;
+            if (cportid < cport_count) {
+                return cportid;
+            }
+        }
+
+        cportid = (cportid & ~31) + 32;
+    }
+
+    return -1;
+}
+
 /**
  * @brief           send data over given UniPro CPort
  * @return          0 on success, -EINVAL on invalid parameter,
  *                  -EBUSY when buffer could not be completely transferred
  *                  (unipro_send_tx_buffer() shall be called again until
  *                  buffer is entirely sent (return value == 0)).
- * @param[in]       operation: greybus loopback operation
+ * @param[in]       cport: CPort handle
+ * @param[out]      progress: set to true if any data was written to the
+ *                  CPort TX FIFO or any buffer was dequeued
  */
-static int unipro_send_tx_buffer(struct cport *cport)
+static int unipro_send_tx_buffer(struct cport *cport, bool *progress)
 {
     irqstate_t flags;
     struct unipro_buffer *buffer;
@@ -158,6 +234,7 @@ static int unipro_send_tx_buffer(struct cport *cport)
     if (retval < 0) {
         unipro_dequeue_tx_buffer(buffer, retval);
         lldbg("unipro_send_sync failed. Dropping message...\n");
+        *progress = true;
         return -EINVAL;
     }
 
@@ -165,6 +242,7 @@ static int unipro_send_tx_buffer(struct cport *cport)
     if (retval > 0) {
         buffer->som = false;
         buffer->byte_sent += retval;
+        *progress = true;
     }
 
     if (buffer->byte_sent >= buffer->len) {
@@ -176,38 +254,74 @@ static int unipro_send_tx_buffer(struct cport *cport)
     return -EBUSY;
 }
 
+/**
+ * @brief           Send up to CONFIG_ARCH_UNIPROTX_MEMCPY_QUANTUM buffers of
+ *                  a CPort, stopping early if its TX FIFO gets full.
+ * @return          true if any progress was made on the CPort
+ * @param[in]       cport: CPort handle
+ */
+static bool unipro_tx_serve_cport(struct cport *cport)
+{
+    bool progress = false;
+    int retval;
+    int i;
+
+    for (i = 0; i < CONFIG_ARCH_UNIPROTX_MEMCPY_QUANTUM; i++) {
+        retval = unipro_send_tx_buffer(cport, &progress);
+        if (retval == -EBUSY || list_is_empty(&cport->tx_fifo)) {
+            break;
+        }
+    }
+
+    unipro_tx_clear_ready(cport);
+
+    return progress;
+}
+
+/**
+ * @brief           Wait for CPort TX FIFOs to drain when none of them could
+ *                  accept any data during a whole round.
+ */
+static void unipro_tx_backoff(void)
+{
+    usleep(CONFIG_ARCH_UNIPROTX_MEMCPY_BACKOFF_US);
+}
+
 /**
  * @brief           Send data buffer(s) on CPort whenever ready.
- *                  Ensure that TX queues are reinspected until
- *                  all CPorts have no work available.
+ *                  Only the CPorts flagged as ready are visited, in
+ *                  round-robin order, until none of them has work left.
  *                  Then suspend again until new data is available.
  */
 static void *unipro_tx_worker(void *data)
 {
-    int i;
-    bool is_busy;
-    int retval;
-    unsigned int cport_count = unipro_cport_count();
+    int cportid;
+    int last_cportid;
+    bool progress;
 
     while (1) {
         /* Block until a buffer is pending on any CPort */
         sem_wait(&worker.tx_fifo_lock);
 
-        do {
-            is_busy = false;
-
-            for (i = 0; i < cport_count; i++) {
-                /* Browse all CPorts sending any pending buffers */
-                retval = unipro_send_tx_buffer(cport_handle(i));
-                if (retval == -EBUSY) {
-                    /*
-                     * Buffer only partially sent, have to try again for
-                     * remaining part.
-                     */
-                    is_busy = true;
+        progress = false;
+        last_cportid = -1;
+
+        while ((cportid = unipro_tx_next_ready(worker.next_cport)) >= 0) {
+            /* Wrapping around means that a whole round has been done */
+            if (cportid <= last_cportid) {
+                if (!progress) {
+                    unipro_tx_backoff();
                 }
+                progress = false;
             }
-        } while (is_busy); /* exit when CPort(s) current pending buffer sent */
+
+            if (unipro_tx_serve_cport(cport_handle(cportid))) {
+                progress = true;
+            }
+
+            last_cportid = cportid;
+            worker.next_cport = cportid + 1;
+        }
     }
 
     return NULL;
@@ -219,6 +333,7 @@ static void unipro_reset_notify_memcpy(unsigned int cportid)
      * if the tx worker is blocked on the semaphore, post something on it
      * in order to unlock it and have the reset happen right away.
      */
+    unipro_tx_set_ready(cportid);
     sem_post(&worker.tx_fifo_lock);
 }
 
@@ -271,6 +386,7 @@ static int unipro_send_async_memcpy(unsigned int cportid, const void *buf, size_
 
     flags = irqsave();
     list_add(&cport->tx_fifo, &buffer->list);
+    unipro_tx_set_ready(cportid);
     irqrestore(flags);
 
     sem_post(&worker.tx_fifo_lock);
@@ -379,7 +495,8 @@ static int unipro_send_sync(unsigned int cportid,
 static struct unipro_tx_calltable calltable = {
     unipro_reset_notify_memcpy,
     unipro_send_memcpy,
-    unipro_send_async_memcpy
+    unipro_send_async_memcpy,
+    NULL
 };
 
 int unipro_tx_init_memcpy(struct unipro_tx_calltable **table)
@@ -30,7 +30,9 @@
 
 #include <errno.h>
 #include <pthread.h>
+#include <stdbool.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <nuttx/util.h>
 #include <nuttx/irq.h>
@@ -56,6 +58,13 @@
 
 #define UNIPRO_DMA_CHANNEL_COUNT CONFIG_ARCH_UNIPROTX_DMA_NUM_CHANNELS
 
+/* Delay before retrying the CPorts whose DMA transfer failed to start */
+#define UNIPRO_DMA_RETRY_DELAY_US 100
+
+#ifndef CONFIG_ARCH_UNIPROTX_DMA_DESC_COUNT
+#   define CONFIG_ARCH_UNIPROTX_DMA_DESC_COUNT 4
+#endif
+
 /*
  * With ES3 or later chip, Toshiba implemented ATABL as HW flow control for
  * Unipro TX FIFO. The following strucure is used to store the info associated
@@ -64,12 +73,19 @@
  * The first two items are allocated when unipro_tx_init_dma() called. The last
  * item, cportid, changes as new Cport is mapped to the request. 0xffff in
  * cporid indicates the request is currently unmapped.
+ *
+ * A channel carries one descriptor at a time, desc being NULL while the
+ * channel is idle.
  */
 struct dma_channel {
     void *chan;
     void *req;
     unsigned int cportid;
     uint32_t saved_tx_water_mark;
+    struct unipro_xfer_descriptor *desc;
+
+    uint32_t xfer_count;
+    uint32_t byte_count;
 };
 
 struct unipro_xfer_descriptor {
@@ -93,6 +109,18 @@ struct unipro_xfer_descriptor_sync {
     int retval;
 };
 
+/*
+ * Per-CPort pool of preallocated transfer descriptors. When a CPort runs out
+ * of descriptors, asynchronous sends fail with -EAGAIN while synchronous
+ * sends wait for a descriptor to be released.
+ */
+struct unipro_desc_pool {
+    struct unipro_xfer_descriptor descs[CONFIG_ARCH_UNIPROTX_DMA_DESC_COUNT];
+    struct list_head free_list;
+    sem_t free_wait;
+    unsigned int waiters;
+};
+
 static struct {
     pthread_t thread;
     sem_t tx_fifo_lock;
@@ -105,6 +133,12 @@ static struct {
     struct list_head free_channel_list;
     sem_t dma_channel_lock;
     int max_channel;
+
+    /* CPorts with a descriptor to start or a reset to process */
+    struct list_head ready_cports;
+    uint32_t channel_stalls;
+
+    struct unipro_desc_pool *desc_pools;
 } unipro_dma;
 
 static uint32_t unipro_read(uint32_t offset) {
@@ -115,29 +149,132 @@ static void unipro_write(uint32_t offset, uint32_t v) {
     putreg32(v, (volatile unsigned int*)(AIO_UNIPRO_BASE + offset));
 }
 
+/**
+ * @brief           Pick an idle DMA channel for a CPort
+ * @return          DMA channel, or NULL if no channel is available
+ * @param[in]       cport: CPort handle
+ *
+ * @note            This function should be called from an atomic context
+ */
 static struct dma_channel *pick_dma_channel(struct cport *cport)
 {
     struct dma_channel *chan;
-    uint32_t chan_index;
+    struct dma_channel *idle_chan = NULL;
+    int i;
 
     /*
      * Reserve GDMAC channel 0 for CPort 0 to avoid control data operations on
      * CPort 0 be blocked by other CPort operations.
      */
-    chan_index = (cport->cportid == 0) ?
-            0 : (((cport->cportid - 1) % (unipro_dma.max_channel - 1)) + 1);
+    if (cport->cportid == 0 || unipro_dma.max_channel == 1) {
+        chan = &unipro_dma.dma_channels[0];
+        return chan->desc ? NULL : chan;
+    }
+
+    /*
+     * Any idle channel will do, but prefer the one already mapped to the
+     * CPort, which saves reconnecting the ATABL request.
+     */
+    for (i = 1; i < unipro_dma.max_channel; i++) {
+        chan = &unipro_dma.dma_channels[i];
+        if (chan->desc)
+            continue;
+
+        if (chan->cportid == cport->cportid)
+            return chan;
+
+        if (!idle_chan)
+            idle_chan = chan;
+    }
+
+    return idle_chan;
+}
+
+/**
+ * @brief           Queue a CPort for the TX worker, unless already queued
+ * @param[in]       cport: CPort handle
+ *
+ * @note            This function should be called from an atomic context
+ */
+static void unipro_dma_tx_set_ready(struct cport *cport)
+{
+    if (list_is_empty(&cport->tx_ready)) {
+        list_add(&unipro_dma.ready_cports, &cport->tx_ready);
+    }
+}
+
+/**
+ * @brief           Release a DMA channel and queue the CPort it was used by
+ *                  for the TX worker, so that its next descriptor gets started.
+ * @param[in]       chan: DMA channel done with its transfer
+ * @param[in]       cport: CPort the transfer was for
+ */
+static void unipro_dma_tx_release_channel(struct dma_channel *chan,
+                                          struct cport *cport)
+{
+    irqstate_t flags;
+
+    flags = irqsave();
+    if (chan) {
+        chan->desc = NULL;
+    }
+    unipro_dma_tx_set_ready(cport);
+    irqrestore(flags);
+}
+
+/**
+ * @brief           Take a transfer descriptor from the pool of a CPort
+ * @return          cleared descriptor, or NULL if the pool is empty
+ * @param[in]       cport: CPort handle
+ *
+ * @note            This function should be called from an atomic context
+ */
+static struct unipro_xfer_descriptor *unipro_desc_alloc(struct cport *cport)
+{
+    struct unipro_desc_pool *pool = &unipro_dma.desc_pools[cport->cportid];
+    struct unipro_xfer_descriptor *desc;
 
-    DEBUGASSERT(chan_index < unipro_dma.max_channel);
+    if (list_is_empty(&pool->free_list)) {
+        return NULL;
+    }
 
-    chan = &unipro_dma.dma_channels[chan_index];
+    desc = containerof(pool->free_list.next, struct unipro_xfer_descriptor,
+                       list);
+    list_del(&desc->list);
 
-    return chan;
+    memset(desc, 0, sizeof(*desc));
+    list_init(&desc->list);
+    desc->cport = cport;
+
+    return desc;
+}
+
+/**
+ * @brief           Give a transfer descriptor back to the pool of its CPort
+ * @param[in]       desc: descriptor, not linked in any list
+ */
+static void unipro_desc_free(struct unipro_xfer_descriptor *desc)
+{
+    struct unipro_desc_pool *pool =
+        &unipro_dma.desc_pools[desc->cport->cportid];
+    irqstate_t flags;
+
+    flags = irqsave();
+    list_add(&pool->free_list, &desc->list);
+    if (pool->waiters) {
+        pool->waiters--;
+        sem_post(&pool->free_wait);
+    }
+    irqrestore(flags);
 }
 
 static void unipro_flush_cport(struct cport *cport)
 {
     struct unipro_xfer_descriptor *desc;
     struct list_head *iterator = NULL, *next = NULL;
+    unipro_send_completion_t callback;
+    const void *data;
+    void *priv;
     irqstate_t flags;
 
     if (list_is_empty(&cport->tx_fifo)) {
@@ -149,14 +286,18 @@ static void unipro_flush_cport(struct cport *cport)
         desc = containerof(iterator, struct unipro_xfer_descriptor, list);
 
         if (desc->channel == NULL) {
+            callback = desc->callback;
+            data = desc->data;
+            priv = desc->priv;
+
             list_del(&desc->list);
             irqrestore(flags);
 
-            if (desc->callback) {
-                desc->callback(-ECONNRESET, desc->data, desc->priv);
+            unipro_desc_free(desc);
+            if (callback) {
+                callback(-ECONNRESET, data, priv);
             }
 
-           free(desc);
            flags = irqsave();
         } else {
             struct dma_channel *desc_chan = desc->channel;
@@ -181,48 +322,16 @@ reset:
     cport->reset_completion_cb = cport->reset_completion_cb_priv = NULL;
 }
 
-static struct unipro_xfer_descriptor *pick_tx_descriptor(unsigned int cportid)
-{
-    struct unipro_xfer_descriptor *desc;
-    unsigned int cport_count = unipro_cport_count();
-    int i;
-
-    for (i = 0; i < cport_count; i++, cportid++) {
-        struct cport *cport;
-
-        cportid = cportid % cport_count;
-        cport = cport_handle(cportid);
-        if (!cport)
-            continue;
-
-        if (list_is_empty(&cport->tx_fifo)) {
-            if (cport->pending_reset) {
-                unipro_flush_cport(cport);
-            }
-
-            continue;
-        }
-
-        if (cport->pending_reset) {
-            unipro_flush_cport(cport);
-        }
-
-        desc = containerof(cport->tx_fifo.next, struct unipro_xfer_descriptor,
-                list);
-        if (desc->channel)
-            continue;
-
-        return desc;
-    }
-
-    return NULL;
-}
-
 static inline void unipro_dma_tx_set_eom_flag(struct cport *cport)
 {
     putreg8(1, CPORT_EOM_BIT(cport));
 }
 
+/*
+ * Unlink a finished descriptor and give it back to the pool of its CPort.
+ * Callers run the completion callback afterwards, so that the callback can
+ * send the next message of the CPort with the descriptor just released.
+ */
 static void unipro_xfer_dequeue_descriptor(struct unipro_xfer_descriptor *desc)
 {
     irqstate_t flags;
@@ -231,13 +340,16 @@ static void unipro_xfer_dequeue_descriptor(struct unipro_xfer_descriptor *desc)
     list_del(&desc->list);
     irqrestore(flags);
 
-    free(desc);
+    unipro_desc_free(desc);
 }
 
 static int unipro_dma_tx_callback(struct device *dev, void *chan,
         struct device_dma_op *op, unsigned int event, void *arg)
 {
     struct unipro_xfer_descriptor *desc = arg;
+    unipro_send_completion_t callback = desc->callback;
+    const void *data = desc->data;
+    void *priv = desc->priv;
     int retval = OK;
 
     if (event & DEVICE_DMA_CALLBACK_EVENT_START) {
@@ -282,25 +394,28 @@ static int unipro_dma_tx_callback(struct device *dev, void *chan,
     if (event & DEVICE_DMA_CALLBACK_EVENT_COMPLETE) {
         if (desc->data_offset >= desc->len) {
             struct dma_channel *desc_chan = desc->channel;
+            struct cport *cport = desc->cport;
 
             unipro_dma_tx_set_eom_flag(desc->cport);
 
             retval = device_dma_op_free(unipro_dma.dev, op);
 
-            if (desc->callback != NULL) {
-                desc->callback(0, desc->data, desc->priv);
-            }
-
             device_atabl_transfer_completed(unipro_dma.atabl_dev,
                                             desc_chan->req);
 
             unipro_xfer_dequeue_descriptor(desc);
+            unipro_dma_tx_release_channel(desc_chan, cport);
+
+            if (callback != NULL) {
+                callback(0, data, priv);
+            }
 
             if (retval != OK) {
                 lldbg("Failed to free DMA op: %d\n", retval);
                 goto event_complete_finally;
             }
         } else {
+            unipro_dma_tx_release_channel(desc->channel, desc->cport);
             desc->channel = NULL;
             retval = device_dma_op_free(unipro_dma.dev, op);
             if (retval != OK) {
@@ -364,13 +479,17 @@ static int unipro_dma_tx_callback(struct device *dev, void *chan,
     }
 
     if (event & DEVICE_DMA_CALLBACK_EVENT_DEQUEUED) {
-        device_dma_op_free(unipro_dma.dev, op);
+        struct dma_channel *desc_chan = desc->channel;
+        struct cport *cport = desc->cport;
 
-        if (desc->callback != NULL) {
-            desc->callback(0, desc->data, desc->priv);
-        }
+        device_dma_op_free(unipro_dma.dev, op);
 
         unipro_xfer_dequeue_descriptor(desc);
+        unipro_dma_tx_release_channel(desc_chan, cport);
+
+        if (callback != NULL) {
+            callback(0, data, priv);
+        }
 
         sem_post(&worker.tx_fifo_lock);
     }
@@ -397,6 +516,7 @@ static int unipro_dma_xfer(struct unipro_xfer_descriptor *desc,
         return retval;
     }
     desc->channel = channel;
+    channel->desc = desc;
 
     dma_op->callback = (void *) unipro_dma_tx_callback;
     dma_op->callback_arg = desc;
@@ -431,29 +551,79 @@ static int unipro_dma_xfer(struct unipro_xfer_descriptor *desc,
     retval = device_dma_enqueue(unipro_dma.dev, channel->chan, dma_op);
     if (retval) {
         desc->channel = NULL;
+        channel->desc = NULL;
         device_dma_op_free(unipro_dma.dev, dma_op);
         lowsyslog("unipro: failed to start DMA transfer: %d\n", retval);
         return retval;
     }
 
+    channel->xfer_count++;
+    channel->byte_count += xfer_len;
+
     return 0;
 }
 
+/**
+ * @brief           Start the pending descriptors of the ready CPorts.
+ *                  CPorts that cannot get a DMA channel are tried again on
+ *                  the next wake up of the worker, which happens at the
+ *                  latest when a DMA channel completes its transfer. CPorts
+ *                  whose transfer failed to start may have no transfer in
+ *                  flight to wake the worker up, so the worker wakes itself
+ *                  up after a short delay to retry them.
+ */
 static void *unipro_tx_worker(void *data)
 {
     struct dma_channel *channel;
     struct unipro_xfer_descriptor *desc;
-    unsigned int next_cport;
+    struct list_head waiting;
+    struct list_head *iter, *next;
+    struct cport *cport;
+    irqstate_t flags;
+    bool retry = false;
     int rc = 0;
 
+    list_init(&waiting);
+
     while (1) {
         /* Block until a buffer is pending on any CPort */
         sem_wait(&worker.tx_fifo_lock);
 
-        next_cport = 0;
-        while ((desc = pick_tx_descriptor(next_cport)) != NULL) {
-            next_cport = desc->cport->cportid + 1;
-            channel = pick_dma_channel(desc->cport);
+        flags = irqsave();
+
+        while (!list_is_empty(&unipro_dma.ready_cports)) {
+            cport = containerof(unipro_dma.ready_cports.next, struct cport,
+                                tx_ready);
+            list_del(&cport->tx_ready);
+
+            if (cport->pending_reset) {
+                irqrestore(flags);
+                unipro_flush_cport(cport);
+                flags = irqsave();
+                continue;
+            }
+
+            if (list_is_empty(&cport->tx_fifo)) {
+                continue;
+            }
+
+            /* The completion of the in-flight descriptor requeues the CPort */
+            desc = containerof(cport->tx_fifo.next,
+                               struct unipro_xfer_descriptor, list);
+            if (desc->channel) {
+                continue;
+            }
+
+            channel = pick_dma_channel(cport);
+            if (!channel) {
+                unipro_dma.channel_stalls++;
+                list_add(&waiting, &cport->tx_ready);
+                continue;
+            }
+
+            /* Reserve the channel before leaving the critical section */
+            channel->desc = desc;
+            irqrestore(flags);
 
             rc = unipro_dma_xfer(desc, channel);
             if (rc) {
@@ -466,6 +636,26 @@ static void *unipro_tx_worker(void *data)
                         break;
                 }
             }
+
+            flags = irqsave();
+            if (rc) {
+                channel->desc = NULL;
+                list_add(&waiting, &cport->tx_ready);
+                retry = true;
+            }
+        }
+
+        list_foreach_safe(&waiting, iter, next) {
+            list_del(iter);
+            list_add(&unipro_dma.ready_cports, iter);
+        }
+
+        irqrestore(flags);
+
+        if (retry) {
+            retry = false;
+            usleep(UNIPRO_DMA_RETRY_DELAY_US);
+            sem_post(&worker.tx_fifo_lock);
         }
     }
 
@@ -474,6 +664,15 @@ static void *unipro_tx_worker(void *data)
 
 static void unipro_reset_notify_dma(unsigned int cportid)
 {
+    struct cport *cport = cport_handle(cportid);
+    irqstate_t flags;
+
+    if (cport) {
+        flags = irqsave();
+        unipro_dma_tx_set_ready(cport);
+        irqrestore(flags);
+    }
+
     /*
      * if the tx worker is blocked on the semaphore, post something on it
      * in order to unlock it and have the reset happen right away.
@@ -481,6 +680,24 @@ static void unipro_reset_notify_dma(unsigned int cportid)
     sem_post(&worker.tx_fifo_lock);
 }
 
+/**
+ * @brief           Print DMA channel utilization
+ */
+static void unipro_tx_info_dma(void)
+{
+    struct dma_channel *chan;
+    int i;
+
+    for (i = 0; i < unipro_dma.max_channel; i++) {
+        chan = &unipro_dma.dma_channels[i];
+        lowsyslog("unipro: DMA channel %d: %s, %u xfers, %u bytes\n", i,
+                  chan->desc ? "busy" : "idle", chan->xfer_count,
+                  chan->byte_count);
+    }
+
+    lowsyslog("unipro: %u DMA channel stalls\n", unipro_dma.channel_stalls);
+}
+
 static int unipro_send_async_dma(unsigned int cportid, const void *buf, size_t len,
         unipro_send_completion_t callback, void *priv)
 {
@@ -499,21 +716,22 @@ static int unipro_send_async_dma(unsigned int cportid, const void *buf, size_t l
         return -EPIPE;
     }
 
-    desc = zalloc(sizeof(*desc));
-    if (!desc)
-        return -ENOMEM;
+    flags = irqsave();
+
+    desc = unipro_desc_alloc(cport);
+    if (!desc) {
+        irqrestore(flags);
+        return -EAGAIN;
+    }
 
     desc->data = buf;
     desc->len = len;
     desc->data_offset = 0;
     desc->callback = callback;
     desc->priv = priv;
-    desc->cport = cport;
 
-    list_init(&desc->list);
-
-    flags = irqsave();
     list_add(&cport->tx_fifo, &desc->list);
+    unipro_dma_tx_set_ready(cport);
     irqrestore(flags);
 
     sem_post(&worker.tx_fifo_lock);
@@ -538,10 +756,31 @@ static int unipro_send_dma(unsigned int cportid, const void *buf, size_t len)
 {
     int retval;
     struct unipro_xfer_descriptor_sync desc;
+    struct unipro_desc_pool *pool;
+    irqstate_t flags;
 
     sem_init(&desc.lock, 0, 0);
 
-    retval = unipro_send_async_dma(cportid, buf, len, unipro_send_cb, &desc);
+    while (1) {
+        retval = unipro_send_async_dma(cportid, buf, len, unipro_send_cb,
+                                       &desc);
+        if (retval != -EAGAIN || up_interrupt_context()) {
+            break;
+        }
+
+        /* Wait for a descriptor of the CPort to be released */
+        pool = &unipro_dma.desc_pools[cportid];
+
+        flags = irqsave();
+        if (list_is_empty(&pool->free_list)) {
+            pool->waiters++;
+            irqrestore(flags);
+            sem_wait(&pool->free_wait);
+        } else {
+            irqrestore(flags);
+        }
+    }
+
     if (retval) {
         goto out;
     }
@@ -558,7 +797,8 @@ out:
 static struct unipro_tx_calltable calltable = {
     unipro_reset_notify_dma,
     unipro_send_dma,
-    unipro_send_async_dma
+    unipro_send_async_dma,
+    unipro_tx_info_dma
 };
 
 int unipro_tx_init_dma(struct unipro_tx_calltable **table)
@@ -613,8 +853,27 @@ int unipro_tx_init_dma(struct unipro_tx_calltable **table)
         return -ENODEV;
     }
 
+    unipro_dma.desc_pools = zalloc(unipro_cport_count() *
+                                   sizeof(*unipro_dma.desc_pools));
+    if (!unipro_dma.desc_pools) {
+        retval = -ENOMEM;
+        goto error_desc_pools;
+    }
+
+    for (i = 0; i < unipro_cport_count(); i++) {
+        struct unipro_desc_pool *pool = &unipro_dma.desc_pools[i];
+        int j;
+
+        list_init(&pool->free_list);
+        sem_init(&pool->free_wait, 0, 0);
+        for (j = 0; j < ARRAY_SIZE(pool->descs); j++) {
+            list_add(&pool->free_list, &pool->descs[j].list);
+        }
+    }
+
     unipro_dma.max_channel = 0;
     list_init(&unipro_dma.free_channel_list);
+    list_init(&unipro_dma.ready_cports);
     avail_chan = device_dma_chan_free_count(unipro_dma.dev);
 
     if (avail_chan > ARRAY_SIZE(unipro_dma.dma_channels)) {
@@ -696,6 +955,10 @@ error_worker_create:
     unipro_dma.max_channel = 0;
 
 error_no_channel:
+    free(unipro_dma.desc_pools);
+    unipro_dma.desc_pools = NULL;
+
+error_desc_pools:
     device_close(unipro_dma.atabl_dev);
     unipro_dma.atabl_dev = NULL;
 
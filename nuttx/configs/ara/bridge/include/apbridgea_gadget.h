@@ -49,6 +49,13 @@
 #define APBRIDGE_WOREQUEST_TIMESYNC_DISABLE         (0x0e)
 #define APBRIDGE_WOREQUEST_TIMESYNC_AUTHORITATIVE   (0x0f)
 #define APBRIDGE_ROREQUEST_TIMESYNC_GET_LAST_EVENT  (0x10)
+#define APBRIDGE_WOREQUEST_AGGREGATION              (0x11)
+
+/* Pending AP-bound messages per direct-mapped endpoint */
+
+#ifndef CONFIG_APBRIDGE_MSG_QUEUE_DEPTH
+#define CONFIG_APBRIDGE_MSG_QUEUE_DEPTH             8
+#endif
 
 struct apbridge_dev_s;
 
@@ -87,9 +87,18 @@ struct usbdev_req_s *get_request(struct usbdev_ep_s *ep,
 void put_request(struct usbdev_req_s *req);
 struct usbdev_req_s *find_request_by_priv(const void *priv);
 struct usbdev_req_s *find_request_by_ep(struct usbdev_ep_s *ep);
+struct usbdev_req_s *find_request_by_buf(const void *buf);
+void request_set_parts(struct usbdev_req_s *req, unsigned int parts);
+void request_get_part(struct usbdev_req_s *req);
+unsigned int request_put_part(struct usbdev_req_s *req);
+void request_set_offset(struct usbdev_req_s *req, size_t offset);
+size_t request_get_offset(struct usbdev_req_s *req);
 struct usbdev_ep_s *request_to_ep(struct usbdev_req_s *req);
 void request_set_priv(struct usbdev_req_s *req, void *priv);
 void *request_get_priv(struct usbdev_req_s *req);
+void request_hold(struct list_head *queue, struct usbdev_req_s *req);
+struct usbdev_req_s *request_first_held(struct list_head *queue);
+void request_unhold(struct usbdev_req_s *req);
 
 int gadget_control_handler(struct gadget_descriptor *g_desc,
                            struct usbdev_s *dev,
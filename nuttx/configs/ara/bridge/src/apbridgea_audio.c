@@ -614,6 +614,7 @@ static void apbridgea_audio_unipro_tx(struct apbridgea_audio_info *info,
     struct apbridga_audio_rb_hdr *rb_hdr;
     struct gb_operation_hdr *gb_hdr;
     struct list_head *iter;
+    unsigned int sent = 0;
     int ret;
 
     rb_hdr = ring_buf_get_buf(rb);
@@ -634,9 +635,20 @@ static void apbridgea_audio_unipro_tx(struct apbridgea_audio_info *info,
                 rb_hdr->not_acked--;
                 dbg_verbose("%s: can't send UniPro message on cport %u, ret %u\n",
                             __func__, cport->data_cportid, ret);
+            } else {
+                sent++;
             }
         }
     }
+
+    /*
+     * When no CPort took the data, e.g. because UniPro is out of TX
+     * descriptors, drop it and give the entry back to the I2S controller.
+     */
+    if (!sent) {
+        ring_buf_reset(rb);
+        ring_buf_pass(rb);
+    }
 }
 
 static void apbridgea_audio_i2s_rx_cb(struct ring_buf *rb,
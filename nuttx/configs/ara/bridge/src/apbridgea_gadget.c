@@ -71,6 +71,9 @@
 #include <arch/board/apbridgea_audio.h>
  #include <arch/board/apbridgea_unipro.h>
 #include <nuttx/greybus/timesync.h>
+#include <nuttx/bufram.h>
+#include <nuttx/wdog.h>
+#include <nuttx/clock.h>
 #include <greybus/control-gb.h>
 
 /****************************************************************************
@@ -101,6 +104,12 @@
 #undef CONFIG_APBRIDGE_CONFIGSTR
 #define CONFIG_APBRIDGE_CONFIGSTR "Bulk"
 
+/* Aggregation of AP-bound messages */
+
+#ifndef CONFIG_APBRIDGE_AGGREGATION_TIMEOUT
+#define CONFIG_APBRIDGE_AGGREGATION_TIMEOUT 0
+#endif
+
 /* Descriptors ****************************************************************/
 
 /* These settings are not modifiable via the NuttX configuration */
@@ -125,6 +134,8 @@
   ((epno - CONFIG_APBRIDGE_EPBULKOUT) >> 1)
 #define BULKEP_TO_N(ep) \
   BULKEPNO_TO_N(USB_EPNO(ep->eplog))
+#define BULKINEP_TO_N(ep) \
+  ((USB_EPNO(ep->eplog) - CONFIG_APBRIDGE_EPBULKIN) >> 1)
 
 /* Number of requests for dedicated endpoints */
 #define APBRIDGE_NREQS_DEDICATED     (2)
@@ -132,6 +143,11 @@
 #define APBRIDGE_MUXED_BULK_EP       (0)
 #define APBRIDGE_REQ_SIZE            (2048)
 
+#ifdef CONFIG_APBRIDGE_AGGREGATION
+#define APBRIDGE_AGGR_TIMEOUT_TICKS \
+    max(MSEC2TICK(CONFIG_APBRIDGE_AGGREGATION_TIMEOUT), 1)
+#endif
+
 #define APBRIDGE_CONFIG_ATTR \
   USB_CONFIG_ATTR_ONE | \
   USB_CONFIG_ATTR_SELFPOWER | \
@@ -182,13 +198,38 @@
  ****************************************************************************/
 
 struct apbridge_msg_s {
-    struct list_head list;
-    struct usbdev_ep_s *ep;
     const void *buf;
     size_t len;
     void *priv;
 };
 
+/*
+ * Messages from UniPro waiting for a free request on one bulk IN endpoint.
+ * Each queued message holds a UniPro RX buffer, so the number of in-flight
+ * RX buffers of the CPorts mapped to the endpoint bounds the depth.
+ */
+struct apbridge_msg_queue {
+    struct apbridge_msg_s *msg;
+    unsigned int size;
+    unsigned int head;
+    unsigned int depth;
+};
+
+#ifdef CONFIG_APBRIDGE_AGGREGATION
+/*
+ * Messages of the multiplexed bulk IN endpoint packed back to back in one
+ * USB transfer.  One buffer is in flight while the other one fills up.
+ */
+struct apbridge_aggr {
+    bool enabled;
+    bool busy;                  /* A transfer is in flight */
+    uint8_t *buf[2];
+    unsigned int fill;          /* Index of the buffer filling up */
+    size_t len;                 /* Bytes in the buffer filling up */
+    struct wdog_s flush_wd;
+};
+#endif
+
 /* This structure describes the internal state of the driver */
 
 struct apbridge_dev_s {
@@ -200,7 +241,12 @@ struct apbridge_dev_s {
 
     struct usbdev_ep_s *ep[APBRIDGE_MAX_ENDPOINTS];
 
-    struct list_head msg_queue;
+    struct apbridge_msg_queue msg_queue[APBRIDGE_NBULKS];
+    /* Requests of bulk out endpoints waiting for room in UniPro TX */
+    struct list_head held_reqs[APBRIDGE_NBULKS];
+#ifdef CONFIG_APBRIDGE_AGGREGATION
+    struct apbridge_aggr aggr;
+#endif
 
     int *cport_to_epin_n;
     int epout_to_cport_n[APBRIDGE_NBULKS];
@@ -690,44 +736,80 @@ static int set_request_count_vendor_request_out(struct usbdev_s *dev,
     return ep_set_requests_count(priv, ep, value);
 }
 
+static int msg_queue_init(struct apbridge_dev_s *priv)
+{
+    int i;
+    unsigned int cport_count = unipro_cport_count();
+    struct apbridge_msg_s *msg;
+
+    /*
+     * Multiplexed CPorts are limited to one in-flight RX buffer each,
+     * direct-mapped ones to CONFIG_APBRIDGE_MSG_QUEUE_DEPTH.
+     */
+    msg = kmm_malloc(sizeof(*msg) * (cport_count +
+                     CONFIG_APBRIDGE_MSG_QUEUE_DEPTH * (APBRIDGE_NBULKS - 1)));
+    if (!msg) {
+        return -ENOMEM;
+    }
+
+    for (i = 0; i < APBRIDGE_NBULKS; i++) {
+        priv->msg_queue[i].msg = msg;
+        if (i == APBRIDGE_MUXED_BULK_EP) {
+            priv->msg_queue[i].size = cport_count;
+        } else {
+            priv->msg_queue[i].size = CONFIG_APBRIDGE_MSG_QUEUE_DEPTH;
+        }
+        msg += priv->msg_queue[i].size;
+    }
+
+    return 0;
+}
+
+static void msg_queue_free(struct apbridge_dev_s *priv)
+{
+    kmm_free(priv->msg_queue[0].msg);
+}
+
+/* Must be called with interrupts disabled */
 static int apbridge_queue(struct apbridge_dev_s *priv, struct usbdev_ep_s *ep,
                           const void *payload, size_t len, void *data)
 {
-    irqstate_t flags;
-    struct apbridge_msg_s *info;
+    struct apbridge_msg_queue *queue = &priv->msg_queue[BULKINEP_TO_N(ep)];
+    struct apbridge_msg_s *msg;
 
-    info = malloc(sizeof(*info));
-    if (!info) {
-        return -ENOMEM;
+    if (queue->depth == queue->size) {
+        return -ENOSPC;
     }
 
-    info->ep = ep;
-    info->buf = payload;
-    info->len = len;
-    info->priv = data;
+    msg = &queue->msg[(queue->head + queue->depth) % queue->size];
+    msg->buf = payload;
+    msg->len = len;
+    msg->priv = data;
 
-    flags = irqsave();
-    list_add(&priv->msg_queue, &info->list);
-    irqrestore(flags);
+    queue->depth++;
 
     return OK;
 }
 
-static struct apbridge_msg_s *apbridge_dequeue(struct apbridge_dev_s *priv)
+static bool apbridge_dequeue(struct apbridge_dev_s *priv,
+                             struct usbdev_ep_s *ep,
+                             struct apbridge_msg_s *msg)
 {
+    struct apbridge_msg_queue *queue = &priv->msg_queue[BULKINEP_TO_N(ep)];
     irqstate_t flags;
-    struct list_head *list;
 
     flags = irqsave();
-    if (list_is_empty(&priv->msg_queue)) {
+    if (!queue->depth) {
         irqrestore(flags);
-        return NULL;
+        return false;
     }
 
-    list = priv->msg_queue.next;
-    list_del(list);
+    *msg = queue->msg[queue->head];
+    queue->head = (queue->head + 1) % queue->size;
+    queue->depth--;
     irqrestore(flags);
-    return list_entry(list, struct apbridge_msg_s, list);
+
+    return true;
 }
 
 void set_cport_id(struct usbdev_ep_s *ep, struct usbdev_req_s *req,
@@ -781,6 +863,321 @@ static int _to_usb_submit(struct usbdev_ep_s *ep, struct usbdev_req_s *req,
     return 0;
 }
 
+/* Give a bulk out request back to its endpoint once UniPro is done with it */
+static int bulk_out_release(struct apbridge_dev_s *priv,
+                            struct usbdev_ep_s *ep, struct usbdev_req_s *req)
+{
+    int ret;
+
+    ret = EP_SUBMIT(ep, req);
+    if (ret != OK) {
+        usbtrace(TRACE_CLSERROR(USBSER_TRACEERR_RDSUBMIT),
+                 (uint16_t) -ret);
+    }
+
+    /*
+     * Little trick to remove the request from ring descriptors.
+     * There no way to remove a request from ring descriptors from gadget.
+     * We need to submit and then cancel the request to let know to the
+     * USB driver we are not going to use this request anymore.
+     */
+    if (!ret && request_count_changed(priv, ep) < 0) {
+        ep_delete_request(priv, ep, req);
+    }
+
+    return ret;
+}
+
+#ifdef CONFIG_APBRIDGE_AGGREGATION
+static void bulk_in_aggr_complete(struct usbdev_ep_s *ep,
+                                  struct usbdev_req_s *req);
+
+static int aggr_init(struct apbridge_dev_s *priv)
+{
+    struct apbridge_aggr *aggr = &priv->aggr;
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(aggr->buf); i++) {
+        aggr->buf[i] =
+            bufram_page_alloc(bufram_size_to_page_count(APBRIDGE_REQ_SIZE));
+        if (!aggr->buf[i]) {
+            goto errout;
+        }
+    }
+
+    wd_static(&aggr->flush_wd);
+    return 0;
+
+errout:
+    while (i--) {
+        bufram_page_free(aggr->buf[i],
+                         bufram_size_to_page_count(APBRIDGE_REQ_SIZE));
+    }
+    return -ENOMEM;
+}
+
+static void aggr_free(struct apbridge_dev_s *priv)
+{
+    struct apbridge_aggr *aggr = &priv->aggr;
+    int i;
+
+    wd_cancel(&aggr->flush_wd);
+    for (i = 0; i < ARRAY_SIZE(aggr->buf); i++) {
+        bufram_page_free(aggr->buf[i],
+                         bufram_size_to_page_count(APBRIDGE_REQ_SIZE));
+    }
+}
+
+static void aggr_timeout(int argc, uint32_t data, ...);
+
+/* Submit the buffer filling up.  Must be called with interrupts disabled */
+static void aggr_flush(struct apbridge_dev_s *priv)
+{
+    struct apbridge_aggr *aggr = &priv->aggr;
+    struct usbdev_ep_s *ep = priv->ep[CONFIG_APBRIDGE_EPBULKIN];
+    struct usbdev_req_s *req;
+    int ret;
+
+    if (aggr->busy || !aggr->len)
+        return;
+
+    wd_cancel(&aggr->flush_wd);
+
+    req = get_request(ep, bulk_in_aggr_complete, 0, NULL);
+    if (!req) {
+        /* Try again a bit later */
+        wd_start(&aggr->flush_wd, 1, aggr_timeout, 1, (uint32_t) priv);
+        return;
+    }
+
+    req->len = aggr->len;
+    req->flags = USBDEV_REQFLAGS_NULLPKT;
+    req->buf = aggr->buf[aggr->fill];
+
+    ret = EP_SUBMIT(ep, req);
+    if (ret != OK) {
+        usbtrace(TRACE_CLSERROR(USBSER_TRACEERR_SUBMITFAIL), (uint16_t) -ret);
+        lldbg("Dropping %u aggregated bytes: %d\n", aggr->len, ret);
+        put_request(req);
+        aggr->len = 0;
+        return;
+    }
+
+    aggr->busy = true;
+    aggr->fill ^= 1;
+    aggr->len = 0;
+}
+
+static void aggr_timeout(int argc, uint32_t data, ...)
+{
+    irqstate_t flags;
+
+    flags = irqsave();
+    aggr_flush((struct apbridge_dev_s *) data);
+    irqrestore(flags);
+}
+
+/*
+ * Copy a message in the buffer filling up and release its UniPro buffer.
+ * Returns false if there is no room for it.  Must be called with interrupts
+ * disabled.
+ */
+static bool aggr_copy(struct apbridge_dev_s *priv, unsigned int cportid,
+                      const void *payload, size_t len)
+{
+    struct apbridge_aggr *aggr = &priv->aggr;
+    struct gb_operation_hdr *hdr;
+
+    if (aggr->len + len > APBRIDGE_REQ_SIZE) {
+        aggr_flush(priv);
+        if (aggr->len) {
+            return false;
+        }
+    }
+
+    hdr = (struct gb_operation_hdr *)(aggr->buf[aggr->fill] + aggr->len);
+    memcpy(hdr, payload, len);
+    hdr->pad[0] = cportid & 0xff;
+
+    aggr->len += len;
+    unipro_rxbuf_free(cportid, (void *) payload);
+    return true;
+}
+
+/* Must be called with interrupts disabled */
+static void aggr_kick(struct apbridge_dev_s *priv)
+{
+    struct apbridge_aggr *aggr = &priv->aggr;
+
+    if (aggr->busy || !aggr->len)
+        return;
+
+    if (!CONFIG_APBRIDGE_AGGREGATION_TIMEOUT) {
+        aggr_flush(priv);
+    } else if (!WDOG_ISACTIVE(&aggr->flush_wd)) {
+        wd_start(&aggr->flush_wd, APBRIDGE_AGGR_TIMEOUT_TICKS,
+                 aggr_timeout, 1, (uint32_t) priv);
+    }
+}
+
+static int aggr_rx_transfer(struct apbridge_dev_s *priv,
+                            struct usbdev_ep_s *ep, unsigned int cportid,
+                            void *payload, size_t len)
+{
+    struct apbridge_msg_queue *queue = &priv->msg_queue[BULKINEP_TO_N(ep)];
+    irqstate_t flags;
+    int ret = 0;
+
+    /*
+     * Messages already waiting for room must go first.  The copy releases
+     * the UniPro buffer right away.
+     */
+    flags = irqsave();
+    if (queue->depth || !aggr_copy(priv, cportid, payload, len)) {
+        ret = apbridge_queue(priv, ep, payload, len, (void*) cportid);
+    } else {
+        aggr_kick(priv);
+    }
+    irqrestore(flags);
+
+    return ret;
+}
+
+static void bulk_in_aggr_complete(struct usbdev_ep_s *ep,
+                                  struct usbdev_req_s *req)
+{
+    struct apbridge_dev_s *priv = ep_to_apbridge(ep);
+    struct apbridge_msg_queue *queue = &priv->msg_queue[BULKINEP_TO_N(ep)];
+    struct apbridge_msg_s *msg;
+    irqstate_t flags;
+
+    if (req->result != OK) {
+        usbtrace(TRACE_CLSERROR(USBSER_TRACEERR_WRUNEXPECTED),
+                 (uint16_t) -req->result);
+    }
+
+    put_request(req);
+
+    flags = irqsave();
+    priv->aggr.busy = false;
+
+    /* Send what came in while the transfer was in flight */
+    aggr_flush(priv);
+
+    /* Then make room for the messages that did not fit */
+    while (queue->depth) {
+        msg = &queue->msg[queue->head];
+        if (!aggr_copy(priv, (unsigned int) msg->priv, msg->buf, msg->len)) {
+            break;
+        }
+        queue->head = (queue->head + 1) % queue->size;
+        queue->depth--;
+    }
+
+    aggr_kick(priv);
+    irqrestore(flags);
+}
+
+static int aggregation_vendor_request_out(struct usbdev_s *dev, uint8_t req,
+                                          uint16_t index, uint16_t value,
+                                          void *buf, uint16_t len)
+{
+    struct apbridge_dev_s *priv = usbdev_to_apbridge(dev);
+    irqstate_t flags;
+
+    flags = irqsave();
+    priv->aggr.enabled = !!value;
+    if (!priv->aggr.enabled) {
+        aggr_flush(priv);
+    }
+    irqrestore(flags);
+
+    return 0;
+}
+
+/*
+ * Split a bulk OUT transfer holding several Greybus messages.  The request
+ * goes back to the endpoint once UniPro has released all of them.  If
+ * UniPro runs out of room, the offset of the next part is kept so that a
+ * held request resumes where it stopped.
+ */
+static int bulk_out_split(struct apbridge_dev_s *priv,
+                          struct usbdev_ep_s *ep, struct usbdev_req_s *req)
+{
+    struct gb_operation_hdr *hdr;
+    unsigned int cportid;
+    size_t offset = request_get_offset(req);
+    size_t size;
+    int ret;
+
+    if (!offset) {
+        /* Check the whole transfer first, so that either all or none is sent */
+        for (; offset < req->xfrd; offset += size) {
+            if (req->xfrd - offset < sizeof(*hdr)) {
+                return -EPROTO;
+            }
+
+            hdr = (struct gb_operation_hdr *)(req->buf + offset);
+            size = le16_to_cpu(hdr->size);
+            if (size < sizeof(*hdr) || size > req->xfrd - offset) {
+                return -EPROTO;
+            }
+        }
+
+        /* This part keeps the request until every part has been sent */
+        request_set_parts(req, 1);
+        offset = 0;
+    }
+
+    for (; offset < req->xfrd; offset += size) {
+        hdr = (struct gb_operation_hdr *)(req->buf + offset);
+        size = le16_to_cpu(hdr->size);
+
+        if (USB_EPNO(ep->eplog) == CONFIG_APBRIDGE_EPBULKOUT) {
+            cportid = hdr->pad[0];
+        } else {
+            cportid = ep_to_cportid(ep);
+        }
+
+        ret = tx_transfer(priv, cportid, hdr, size);
+        if (ret == -EAGAIN) {
+            request_set_offset(req, offset);
+            return ret;
+        }
+
+        if (ret) {
+            lowsyslog("USB to UniPro transfer failed: %d\n", ret);
+        } else {
+            request_get_part(req);
+        }
+    }
+
+    request_set_offset(req, 0);
+    if (!request_put_part(req)) {
+        bulk_out_release(priv, ep, req);
+    }
+
+    return 0;
+}
+#endif
+
+static int bulk_out_transfer(struct apbridge_dev_s *priv,
+                             struct usbdev_ep_s *ep, struct usbdev_req_s *req)
+{
+    unsigned int cportid;
+
+#ifdef CONFIG_APBRIDGE_AGGREGATION
+    struct gb_operation_hdr *hdr = (struct gb_operation_hdr *) req->buf;
+
+    if (req->xfrd >= sizeof(*hdr) && req->xfrd > le16_to_cpu(hdr->size)) {
+        return bulk_out_split(priv, ep, req);
+    }
+#endif
+
+    cportid = get_cport_id(priv, ep, req);
+    return tx_transfer(priv, cportid, req->buf, req->xfrd);
+}
+
 /**
  * @brief Send incoming data from unipro to AP module
  * priv usb device.
@@ -794,50 +1191,123 @@ int usb_rx_transfer(unsigned int cportid,
 {
     struct usbdev_ep_s *ep;
     struct usbdev_req_s *req;
+    irqstate_t flags;
+    int ret;
 
     if (len > APBRIDGE_REQ_SIZE)
         return -EINVAL;
 
     ep = cportid_to_ep(priv, cportid);
 
-    /* Bulk in request use UniPro buffer so only get a request without buffer */
+#ifdef CONFIG_APBRIDGE_AGGREGATION
+    if (((struct apbridge_dev_s *) priv)->aggr.enabled &&
+        USB_EPNO(ep->eplog) == CONFIG_APBRIDGE_EPBULKIN) {
+        return aggr_rx_transfer(priv, ep, cportid, payload, len);
+    }
+#endif
+
+    /*
+     * Bulk in request use UniPro buffer so only get a request without buffer.
+     * If there is none, queue the message until bulk_in_complete() releases
+     * one.  Both must happen atomically, or a request released in between
+     * would leave the message in the queue.
+     */
+    flags = irqsave();
     req = get_request(ep, bulk_in_complete, 0,
                       (void*) cportid);
     if (!req) {
-        return apbridge_queue(priv, ep, payload, len, (void*) cportid);
+        ret = apbridge_queue(priv, ep, payload, len, (void*) cportid);
+        irqrestore(flags);
+        if (ret) {
+            lldbg("No room to queue message from CP%u\n", cportid);
+        }
+        return ret;
     }
+    irqrestore(flags);
 
     return _to_usb_submit(ep, req, cportid, payload, len);
 }
 
-int usb_release_buffer(struct apbridge_dev_s *priv, const void *buf)
+/*
+ * Forward a request received on a bulk out endpoint to UniPro.
+ * If UniPro has no room for the message, the request is held back instead
+ * of being given back to the endpoint, so the host can not send more than
+ * UniPro takes. Once a request is held, the following requests of the same
+ * endpoint are held behind it to keep the messages in order.
+ */
+static int bulk_out_forward(struct apbridge_dev_s *priv,
+                            struct usbdev_ep_s *ep, struct usbdev_req_s *req)
+{
+    struct list_head *held = &priv->held_reqs[BULKEP_TO_N(ep)];
+    irqstate_t flags;
+    int ret = 0;
+
+    flags = irqsave();
+    if (list_is_empty(held)) {
+        ret = bulk_out_transfer(priv, ep, req);
+    }
+
+    if (!list_is_empty(held) || ret == -EAGAIN) {
+        request_hold(held, req);
+        ret = 0;
+    }
+    irqrestore(flags);
+
+    return ret;
+}
+
+/*
+ * Forward the held requests, oldest first, until UniPro runs out of room
+ * again. Called each time UniPro is done with a message from USB.
+ */
+static void bulk_out_resume(struct apbridge_dev_s *priv)
 {
     struct usbdev_ep_s *ep;
     struct usbdev_req_s *req;
-    int ret = 0;
+    irqstate_t flags;
+    int ret;
+    int i;
 
+    flags = irqsave();
+    for (i = 0; i < APBRIDGE_NBULKS; i++) {
+        while ((req = request_first_held(&priv->held_reqs[i]))) {
+            ep = request_to_ep(req);
+            ret = bulk_out_transfer(priv, ep, req);
+            if (ret == -EAGAIN)
+                break;
+
+            request_unhold(req);
+            if (ret) {
+                lowsyslog("USB to UniPro transfer failed: %d\n", ret);
+                EP_SUBMIT(ep, req);
+            }
+        }
+    }
+    irqrestore(flags);
+}
+
+int usb_release_buffer(struct apbridge_dev_s *priv, const void *buf)
+{
+    struct usbdev_req_s *req;
+    int ret;
 
     req = find_request_by_priv(buf);
+#ifdef CONFIG_APBRIDGE_AGGREGATION
+    if (!req) {
+        /* Part of a split transfer */
+        req = find_request_by_buf(buf);
+    }
+    if (req && request_put_part(req)) {
+        return 0;
+    }
+#endif
     if (!req) {
         return -EINVAL;
     }
 
-    ep = request_to_ep(req);
-    ret = EP_SUBMIT(ep, req);
-    if (ret != OK) {
-        usbtrace(TRACE_CLSERROR(USBSER_TRACEERR_RDSUBMIT),
-                 (uint16_t) -ret);
-    }
+    ret = bulk_out_release(priv, request_to_ep(req), req);
+    bulk_out_resume(priv);
 
-    /*
-     * Little trick to remove the request from ring descriptors.
-     * There no way to remove a request from ring descriptors from gadget.
-     * We need to submit and then cancel the request to let know to the
-     * USB driver we are not going to use this request anymore.
-     */
-    if (!ret && request_count_changed(priv, ep) < 0) {
-        ep_delete_request(priv, ep, req);
-    }
     return ret;
 }
 
@@ -889,6 +1359,8 @@ static inline void usbclass_mkepdesc(const struct usb_epdesc_s *indesc,
 
 static void usbclass_resetconfig(struct apbridge_dev_s *priv)
 {
+    struct usbdev_req_s *req;
+    irqstate_t flags;
     int i;
 
     /* Are we configured? */
@@ -898,6 +1370,24 @@ static void usbclass_resetconfig(struct apbridge_dev_s *priv)
 
         priv->config = APBRIDGE_CONFIGIDNONE;
 
+        /*
+         * Give the held requests back without forwarding their data.  A split
+         * request whose first parts were sent goes back once UniPro has
+         * released them.
+         */
+
+        flags = irqsave();
+        for (i = 0; i < APBRIDGE_NBULKS; i++) {
+            while ((req = request_first_held(&priv->held_reqs[i]))) {
+                request_unhold(req);
+                request_set_offset(req, 0);
+                if (!request_put_part(req)) {
+                    EP_SUBMIT(request_to_ep(req), req);
+                }
+            }
+        }
+        irqrestore(flags);
+
         /* Disable endpoints.  This should force completion of all pending
          * transfers.
          */
@@ -1032,7 +1522,6 @@ static void bulk_out_complete(struct usbdev_ep_s *ep,
                               struct usbdev_req_s *req)
 {
     struct apbridge_dev_s *priv;
-    unsigned int cportid;
 
     /* Sanity check */
 
@@ -1052,8 +1541,7 @@ static void bulk_out_complete(struct usbdev_ep_s *ep,
     switch (req->result) {
     case OK:                    /* Normal completion */
         usbtrace(TRACE_CLASSRDCOMPLETE, 0);
-        cportid = get_cport_id(priv, ep, req);
-        if (!tx_transfer(priv, cportid, req->buf, req->xfrd))
+        if (!bulk_out_forward(priv, ep, req))
             return;
 
     case -ESHUTDOWN:           /* Disconnection */
@@ -1076,7 +1564,7 @@ static void bulk_out_complete(struct usbdev_ep_s *ep,
 static void bulk_in_complete(struct usbdev_ep_s *ep,
                              struct usbdev_req_s *req)
 {
-    struct apbridge_msg_s *info;
+    struct apbridge_msg_s msg;
     struct apbridge_dev_s *priv;
 
     /* Sanity check */
@@ -1090,12 +1578,9 @@ static void bulk_in_complete(struct usbdev_ep_s *ep,
     unipro_rxbuf_free((unsigned int) request_get_priv(req), req->buf);
 
     priv = ep_to_apbridge(ep);
-    info = apbridge_dequeue(priv);
-    if (info) {
-        request_set_priv(req, info->priv);
-        _to_usb_submit(info->ep, req,
-                       (unsigned int)info->priv, info->buf, info->len);
-        free(info);
+    if (apbridge_dequeue(priv, ep, &msg)) {
+        request_set_priv(req, msg.priv);
+        _to_usb_submit(ep, req, (unsigned int)msg.priv, msg.buf, msg.len);
     } else {
         put_request(req);
     }
@@ -1697,6 +2182,7 @@ int usbdev_apbinitialize(struct device *dev)
     struct apbridge_dev_s *priv;
     struct usbdevclass_driver_s *drvr;
     int ret = -ENOMEM;
+    int i;
 
     /* Register USB vendor requests */
     if (register_vendor_request(APBRIDGE_RWREQUEST_LOG, VENDOR_REQ_IN,
@@ -1719,6 +2205,11 @@ int usbdev_apbinitialize(struct device *dev)
                                 VENDOR_REQ_DATA,
                                 apbridgea_audio_vendor_request_out))
         goto errout_vendor_req;
+#endif
+#ifdef CONFIG_APBRIDGE_AGGREGATION
+    if (register_vendor_request(APBRIDGE_WOREQUEST_AGGREGATION, VENDOR_REQ_OUT,
+                                aggregation_vendor_request_out))
+        goto errout_vendor_req;
 #endif
     if (register_vendor_request(APBRIDGE_WOREQUEST_TIMESYNC_ENABLE, VENDOR_REQ_DATA,
                                 timesync_enable_vendor_request_out))
@@ -1759,8 +2250,20 @@ int usbdev_apbinitialize(struct device *dev)
         goto errout_with_cport_callback;
     }
 
+    if (msg_queue_init(priv)) {
+        goto errout_with_msg_queue;
+    }
+
+#ifdef CONFIG_APBRIDGE_AGGREGATION
+    if (aggr_init(priv)) {
+        goto errout_with_aggr;
+    }
+#endif
+
     sem_init(&priv->config_sem, 0, 0);
-    list_init(&priv->msg_queue);
+    for (i = 0; i < APBRIDGE_NBULKS; i++) {
+        list_init(&priv->held_reqs[i]);
+    }
 
     /* Initialize the USB class driver structure */
 
@@ -1781,6 +2284,12 @@ int usbdev_apbinitialize(struct device *dev)
 
 errout_cport_table:
     device_usbdev_unregister_gadget(dev, drvr);
+#ifdef CONFIG_APBRIDGE_AGGREGATION
+    aggr_free(priv);
+errout_with_aggr:
+#endif
+    msg_queue_free(priv);
+errout_with_msg_queue:
     cport_callback_free(priv);
 errout_with_cport_callback:
     map_table_free(priv);
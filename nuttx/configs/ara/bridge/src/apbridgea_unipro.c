@@ -50,6 +50,18 @@
 #define ONE_SEC_IN_MSEC         1000
 #define RESET_TIMEOUT_DELAY (TIMEOUT_IN_MS * CLOCKS_PER_SEC) / ONE_SEC_IN_MSEC
 
+/*
+ * Messages from direct-mapped CPorts wait in a queue of
+ * CONFIG_APBRIDGE_MSG_QUEUE_DEPTH entries for a free USB request: hold
+ * back UniPro RX before it can overflow.
+ */
+#if CONFIG_TSB_UNIPRO_MAX_INFLIGHT_BUFCOUNT == 0 || \
+    CONFIG_TSB_UNIPRO_MAX_INFLIGHT_BUFCOUNT > CONFIG_APBRIDGE_MSG_QUEUE_DEPTH
+#define DIRECT_EP_MAX_INFLIGHT_BUFCOUNT CONFIG_APBRIDGE_MSG_QUEUE_DEPTH
+#else
+#define DIRECT_EP_MAX_INFLIGHT_BUFCOUNT CONFIG_TSB_UNIPRO_MAX_INFLIGHT_BUFCOUNT
+#endif
+
 static sem_t linkup_sem;
 static pthread_t g_apbridge_thread;
 
@@ -219,7 +231,7 @@ void unipro_cport_mapping(unsigned int cportid, enum ep_mapping mapping)
 
     case DIRECT_EP:
         unipro_set_max_inflight_rxbuf_count(cportid,
-                                    CONFIG_TSB_UNIPRO_MAX_INFLIGHT_BUFCOUNT);
+                                            DIRECT_EP_MAX_INFLIGHT_BUFCOUNT);
         break;
     }
 }
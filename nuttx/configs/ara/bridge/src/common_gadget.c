@@ -38,10 +38,13 @@
 
 struct request_list {
     struct list_head list;
+    struct list_head held;      /* link in a queue of held requests */
     struct usbdev_ep_s *ep;
     struct usbdev_req_s *req;
     size_t len;                 /* size of allocated buffer */
     void *priv;
+    unsigned int parts;         /* parts of the buffer still in use */
+    size_t offset;              /* where to resume sending the parts */
 };
 
 struct request_pool {
@@ -184,6 +187,46 @@ void *request_get_priv(struct usbdev_req_s *req)
     return req_list->priv;
 }
 
+/*
+ * Hold back a request whose data can not be processed yet.
+ * Must be called with interrupts disabled.
+ * \param queue queue of held requests, oldest first
+ * \param req request's pointer
+ */
+void request_hold(struct list_head *queue, struct usbdev_req_s *req)
+{
+    struct request_list *req_list = req->priv;
+    list_add(queue, &req_list->held);
+}
+
+/*
+ * Get the oldest request of a queue of held requests.
+ * Must be called with interrupts disabled.
+ * \param queue queue of held requests
+ * \return request's pointer or NULL if the queue is empty
+ */
+struct usbdev_req_s *request_first_held(struct list_head *queue)
+{
+    struct request_list *req_list;
+
+    if (list_is_empty(queue))
+        return NULL;
+
+    req_list = list_entry(queue->next, struct request_list, held);
+    return req_list->req;
+}
+
+/*
+ * Remove a request from its queue of held requests.
+ * Must be called with interrupts disabled.
+ * \param req request's pointer
+ */
+void request_unhold(struct usbdev_req_s *req)
+{
+    struct request_list *req_list = req->priv;
+    list_del(&req_list->held);
+}
+
 /*
  * \brief Get a request from request manager
  * Allocate a new request a return one from the request pool.
@@ -240,6 +283,8 @@ struct usbdev_req_s *get_request(struct usbdev_ep_s *ep,
         irqrestore(flags);
     }
     req_list->priv = priv;
+    req_list->parts = 0;
+    req_list->offset = 0;
     req_list->ep = ep;
 
     flags = irqsave();
@@ -328,6 +373,104 @@ struct usbdev_req_s *find_request_by_ep(struct usbdev_ep_s *ep)
     return NULL;
 }
 
+/*
+ * Look up a request in request pool using an address in its buffer
+ * \param buf pointer to look up
+ * \return request's pointer or NULL if request can not be found
+ */
+struct usbdev_req_s *find_request_by_buf(const void *buf)
+{
+    struct list_head *pool_iter, *req_iter;
+    struct request_pool *pool;
+    struct request_list *req_list;
+    const uint8_t *start;
+    irqstate_t flags;
+
+    list_foreach(&request_pool, pool_iter) {
+        pool = list_entry(pool_iter, struct request_pool, pool);
+        flags = irqsave();
+        list_foreach(&pool->request_in_use, req_iter) {
+            req_list = list_entry(req_iter, struct request_list, list);
+            start = req_list->req->buf;
+            if (start && (const uint8_t *)buf >= start &&
+                (const uint8_t *)buf < start + req_list->len) {
+                irqrestore(flags);
+                return req_list->req;
+            }
+        }
+        irqrestore(flags);
+    }
+    return NULL;
+}
+
+/*
+ * Set the number of parts of the request buffer that are used separately
+ * \param req request's pointer
+ * \param parts number of parts
+ */
+void request_set_parts(struct usbdev_req_s *req, unsigned int parts)
+{
+    struct request_list *req_list = req->priv;
+    req_list->parts = parts;
+}
+
+/*
+ * Take one more part of the request buffer
+ * \param req request's pointer
+ */
+void request_get_part(struct usbdev_req_s *req)
+{
+    struct request_list *req_list = req->priv;
+    irqstate_t flags;
+
+    flags = irqsave();
+    req_list->parts++;
+    irqrestore(flags);
+}
+
+/*
+ * Release one part of the request buffer
+ * \param req request's pointer
+ * \return the number of parts still in use
+ */
+unsigned int request_put_part(struct usbdev_req_s *req)
+{
+    struct request_list *req_list = req->priv;
+    unsigned int parts;
+    irqstate_t flags;
+
+    flags = irqsave();
+    if (req_list->parts) {
+        req_list->parts--;
+    }
+    parts = req_list->parts;
+    irqrestore(flags);
+
+    return parts;
+}
+
+/*
+ * Set the offset of the first part of the request buffer not sent yet
+ * \param req request's pointer
+ * \param offset offset in the buffer, 0 once every part was sent
+ */
+void request_set_offset(struct usbdev_req_s *req, size_t offset)
+{
+    struct request_list *req_list = req->priv;
+    req_list->offset = offset;
+}
+
+/*
+ * Get the offset of the first part of the request buffer not sent yet
+ * \param req request's pointer
+ * \return offset in the buffer
+ */
+size_t request_get_offset(struct usbdev_req_s *req)
+{
+    struct request_list *req_list = req->priv;
+    return req_list->offset;
+}
+
 /*
  * Get the endpoint that use the request
  * \param req request's pointer
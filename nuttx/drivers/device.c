@@ -46,46 +46,38 @@
 struct device *device_open(char *type, unsigned int id)
 {
     struct device *dev;
-    struct device_table_iter iter = DEVICE_TABLE_ITER_INITIALIZER;
     irqstate_t flags;
     int ret;
 
     if (!type)
         return NULL;
 
-    flags = irqsave();
+    dev = device_table_find(type, id);
+    if (!dev)
+        return NULL;
 
-    device_table_for_each_dev(dev, &iter) {
-        if (!strcmp(dev->type, type) && (dev->id == id)) {
-            if (dev->state != DEVICE_STATE_PROBED)
-                goto err_irqrestore;
+    flags = irqsave();
 
-            dev->state = DEVICE_STATE_OPENING;
+    if (dev->state != DEVICE_STATE_PROBED) {
+        irqrestore(flags);
+        return NULL;
+    }
 
-            if (dev->driver->ops->open) {
-                irqrestore(flags);
-                ret = dev->driver->ops->open(dev);
-                flags = irqsave();
+    dev->state = DEVICE_STATE_OPENING;
 
-                if (ret) {
-                    dev->state = DEVICE_STATE_PROBED;
-                    goto err_irqrestore;
-                }
-            }
+    irqrestore(flags);
 
-            dev->state = DEVICE_STATE_OPEN;
-            break;
+    if (dev->driver->ops->open) {
+        ret = dev->driver->ops->open(dev);
+        if (ret) {
+            dev->state = DEVICE_STATE_PROBED;
+            return NULL;
         }
     }
 
-    irqrestore(flags);
+    dev->state = DEVICE_STATE_OPEN;
 
     return dev;
-
-err_irqrestore:
-    irqrestore(flags);
-
-    return NULL;
 }
 
 /**
@@ -135,35 +127,34 @@ int device_register_driver(struct device_driver *driver)
     if (!driver || !driver->type || !driver->name || !driver->ops)
         return -EINVAL;
 
-    flags = irqsave();
-
     device_table_for_each_dev(dev, &iter) {
-        if (!strcmp(dev->type, driver->type) &&
-            !strcmp(dev->name, driver->name)) {
+        if (strcmp(dev->type, driver->type) ||
+            strcmp(dev->name, driver->name))
+            continue;
 
-            if (dev->state != DEVICE_STATE_REMOVED)
-                continue;
+        flags = irqsave();
+
+        if (dev->state != DEVICE_STATE_REMOVED) {
+            irqrestore(flags);
+            continue;
+        }
 
-            dev->driver = driver;
-            dev->state = DEVICE_STATE_PROBING;
+        dev->driver = driver;
+        dev->state = DEVICE_STATE_PROBING;
 
-            if (driver->ops->probe) {
-                irqrestore(flags);
-                ret = driver->ops->probe(dev);
-                flags = irqsave();
+        irqrestore(flags);
 
-                if (ret) {
-                    dev->state = DEVICE_STATE_REMOVED;
-                    dev->driver = NULL;
-                    continue;
-                }
+        if (driver->ops->probe) {
+            ret = driver->ops->probe(dev);
+            if (ret) {
+                dev->driver = NULL;
+                dev->state = DEVICE_STATE_REMOVED;
+                continue;
             }
-
-            dev->state = DEVICE_STATE_PROBED;
         }
-    }
 
-    irqrestore(flags);
+        dev->state = DEVICE_STATE_PROBED;
+    }
 
     return 0;
 }
@@ -181,25 +172,25 @@ void device_unregister_driver(struct device_driver *driver)
     if (!driver)
         return;
 
-    flags = irqsave();
-
     device_table_for_each_dev(dev, &iter) {
-        if (dev->driver == driver) {
-            if (dev->state != DEVICE_STATE_PROBED)
-                continue;
+        if (dev->driver != driver)
+            continue;
 
-            dev->state = DEVICE_STATE_REMOVING;
-
-            if (driver->ops->remove) {
-                irqrestore(flags);
-                driver->ops->remove(dev);
-                flags = irqsave();
-            }
+        flags = irqsave();
 
-            dev->driver = NULL;
-            dev->state = DEVICE_STATE_REMOVED;
+        if (dev->state != DEVICE_STATE_PROBED) {
+            irqrestore(flags);
+            continue;
         }
-    }
 
-    irqrestore(flags);
+        dev->state = DEVICE_STATE_REMOVING;
+
+        irqrestore(flags);
+
+        if (driver->ops->remove)
+            driver->ops->remove(dev);
+
+        dev->driver = NULL;
+        dev->state = DEVICE_STATE_REMOVED;
+    }
 }
@@ -30,13 +30,85 @@
  */
 
 #include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <arch/irq.h>
 
 #include <nuttx/list.h>
 #include <nuttx/device.h>
 #include <nuttx/device_table.h>
 #include <nuttx/kmalloc.h>
 
+#define DEVICE_INDEX_BUCKET_COUNT   32
+#define DEVICE_INDEX_BUCKET_MASK    (DEVICE_INDEX_BUCKET_COUNT - 1)
+
+/*
+ * Index of all the devices by (type, id), filled when a device table gets
+ * registered. The hash of the device type is computed once at that time.
+ */
+struct device_index_entry {
+    struct list_head list;
+    struct device *device;
+    uint32_t type_hash;
+};
+
 static LIST_DECLARE(device_table_list);
+static struct list_head device_index[DEVICE_INDEX_BUCKET_COUNT];
+static bool device_index_initialized;
+
+/* FNV-1a */
+static uint32_t device_type_hash(const char *type)
+{
+    uint32_t hash = 2166136261u;
+
+    while (*type) {
+        hash ^= (uint8_t) *type++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static struct list_head *device_index_bucket(uint32_t type_hash,
+                                             unsigned int id)
+{
+    return &device_index[(type_hash + id) & DEVICE_INDEX_BUCKET_MASK];
+}
+
+/**
+ * @brief Find a device by type and identifier
+ * @param type Type of the device
+ * @param id Identifier of the device within its type
+ * @return The first registered device matching type and id, or NULL
+ */
+struct device *device_table_find(const char *type, unsigned int id)
+{
+    struct device_index_entry *entry;
+    struct list_head *bucket;
+    struct list_head *iter;
+    uint32_t type_hash;
+
+    if (!type || !device_index_initialized) {
+        return NULL;
+    }
+
+    type_hash = device_type_hash(type);
+    bucket = device_index_bucket(type_hash, id);
+
+    list_foreach(bucket, iter) {
+        entry = list_entry(iter, struct device_index_entry, list);
+        if (entry->type_hash != type_hash || entry->device->id != id) {
+            continue;
+        }
+
+        if (entry->device->type == type || !strcmp(entry->device->type, type)) {
+            return entry->device;
+        }
+    }
+
+    return NULL;
+}
 
 struct device *device_table_iter_next(struct device_table_iter *iter)
 {
@@ -82,12 +154,42 @@ struct device *device_table_iter_next(struct device_table_iter *iter)
  */
 int device_table_register(struct device_table *table)
 {
+    struct device_index_entry *entries;
+    struct device *dev;
+    irqstate_t flags;
+    unsigned int i;
+
     if (!table || !table->device || !table->device_count) {
         return -EINVAL;
     }
 
+    entries = kmm_zalloc(table->device_count * sizeof(*entries));
+    if (!entries) {
+        return -ENOMEM;
+    }
+
+    flags = irqsave();
+
+    if (!device_index_initialized) {
+        for (i = 0; i < DEVICE_INDEX_BUCKET_COUNT; i++) {
+            list_init(&device_index[i]);
+        }
+        device_index_initialized = true;
+    }
+
+    for (i = 0; i < table->device_count; i++) {
+        dev = &table->device[i];
+
+        entries[i].device = dev;
+        entries[i].type_hash = device_type_hash(dev->type);
+        list_add(device_index_bucket(entries[i].type_hash, dev->id),
+                 &entries[i].list);
+    }
+
     list_init(&table->list);
     list_add(&device_table_list, &table->list);
 
+    irqrestore(flags);
+
     return 0;
 }
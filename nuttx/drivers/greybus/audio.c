@@ -47,6 +47,7 @@
 #include <nuttx/greybus/greybus.h>
 #include <nuttx/greybus/debug.h>
 #include <nuttx/unipro/unipro.h>
+#include <apps/greybus-utils/greybus_manifest.h>
 
 #include <arch/byteorder.h>
 
@@ -1698,6 +1699,8 @@ void gb_audio_mgmt_register(int mgmt_cport, int bundle)
 {
     gb_register_driver(mgmt_cport, bundle, &gb_audio_mgmt_driver);
 }
+GB_PROTOCOL_DRIVER(audio_mgmt, GREYBUS_PROTOCOL_AUDIO_MGMT,
+                   gb_audio_mgmt_register);
 
 static uint8_t gb_audio_send_data_handler(struct gb_operation *operation)
 {
@@ -1767,6 +1770,7 @@ static struct gb_operation_handler gb_audio_data_handlers[] = {
 };
 
 static struct gb_driver gb_audio_data_driver = {
+    .priority           = GB_DRIVER_PRIORITY_HIGH,
     .op_handlers        = gb_audio_data_handlers,
     .op_handlers_count  = ARRAY_SIZE(gb_audio_data_handlers),
 };
@@ -1775,3 +1779,5 @@ void gb_audio_data_register(int data_cport, int bundle)
 {
     gb_register_driver(data_cport, bundle, &gb_audio_data_driver);
 }
+GB_PROTOCOL_DRIVER(audio_data, GREYBUS_PROTOCOL_AUDIO_DATA,
+                   gb_audio_data_register);
@@ -37,6 +37,7 @@
 #include <nuttx/greybus/greybus.h>
 #include <nuttx/greybus/debug.h>
 #include <apps/greybus-utils/utils.h>
+#include <apps/greybus-utils/greybus_manifest.h>
 #include <arch/byteorder.h>
 
 #include "camera-gb.h"
@@ -502,6 +503,7 @@ static struct gb_operation_handler gb_camera_handlers[] = {
 static struct gb_driver gb_camera_driver = {
     .init = gb_camera_init,
     .exit = gb_camera_exit,
+    .priority = GB_DRIVER_PRIORITY_HIGH,
     .op_handlers = gb_camera_handlers,
     .op_handlers_count = ARRAY_SIZE(gb_camera_handlers),
 };
@@ -516,3 +518,4 @@ void gb_camera_register(int cport, int bundle)
 {
     gb_register_driver(cport, bundle, &gb_camera_driver);
 }
+GB_PROTOCOL_DRIVER(camera, GREYBUS_PROTOCOL_CAMERA_MGMT, gb_camera_register);
@@ -37,6 +37,7 @@
 #include <nuttx/device.h>
 #include <nuttx/greybus/timesync.h>
 #include <apps/greybus-utils/manifest.h>
+#include <apps/greybus-utils/greybus_manifest.h>
 
 #include "control-gb.h"
 
@@ -359,3 +360,4 @@ void gb_control_register(int cport, int bundle)
     unipro_enable_fct_tx_flow(cport);
     gb_listen(cport);
 }
+GB_PROTOCOL_DRIVER(control, GREYBUS_PROTOCOL_CONTROL, gb_control_register);
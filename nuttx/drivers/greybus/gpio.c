@@ -34,6 +34,7 @@
 
 #include <arch/byteorder.h>
 #include <nuttx/gpio.h>
+#include <apps/greybus-utils/greybus_manifest.h>
 
 #define GB_GPIO_VERSION_MAJOR 0
 #define GB_GPIO_VERSION_MINOR 1
@@ -338,6 +339,7 @@ static struct gb_operation_handler gb_gpio_handlers[] = {
 };
 
 struct gb_driver gpio_driver = {
+    .priority = GB_DRIVER_PRIORITY_HIGH,
     .op_handlers = (struct gb_operation_handler*) gb_gpio_handlers,
     .op_handlers_count = ARRAY_SIZE(gb_gpio_handlers),
 };
@@ -347,3 +349,4 @@ void gb_gpio_register(int cport, int bundle)
     g_gpio_cport = cport;
     gb_register_driver(cport, bundle, &gpio_driver);
 }
+GB_PROTOCOL_DRIVER(gpio, GREYBUS_PROTOCOL_GPIO, gb_gpio_register);
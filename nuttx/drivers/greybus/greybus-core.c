@@ -29,12 +29,15 @@
  */
 
 #include <nuttx/config.h>
+#include <nuttx/arch.h>
+#include <nuttx/clock.h>
 #include <nuttx/list.h>
 #include <nuttx/unipro/unipro.h>
 #include <nuttx/greybus/greybus.h>
 #include <nuttx/greybus/tape.h>
 #include <nuttx/greybus/debug.h>
 #include <nuttx/wdog.h>
+#include <nuttx/sched_trace.h>
 #include <loopback-gb.h>
 
 #include <apps/greybus-utils/manifest.h>
@@ -43,6 +46,8 @@
 #include <arch/byteorder.h>
 
 #include <stdio.h>
+#include <time.h>
+#include <unistd.h>
 #include <string.h>
 #include <errno.h>
 
@@ -50,25 +55,77 @@
 #define TIMEOUT_IN_MS           1000
 #define GB_PING_TYPE            0x00
 
-#define ONE_SEC_IN_MSEC         1000
-#define ONE_MSEC_IN_NSEC        1000000
+#ifndef CONFIG_GREYBUS_TAPE_BUFFER_SIZE
+#define CONFIG_GREYBUS_TAPE_BUFFER_SIZE 4096
+#endif
+
+#define GB_TAPE_BUFFER_MASK     (CONFIG_GREYBUS_TAPE_BUFFER_SIZE - 1)
 
-#define TIMEOUT_WD_DELAY    (TIMEOUT_IN_MS * CLOCKS_PER_SEC) / ONE_SEC_IN_MSEC
+#ifndef CONFIG_GREYBUS_INFLIGHT_HASH_ORDER
+#define CONFIG_GREYBUS_INFLIGHT_HASH_ORDER 4
+#endif
+
+#define GB_INFLIGHT_BUCKET_COUNT    (1 << CONFIG_GREYBUS_INFLIGHT_HASH_ORDER)
+#define GB_INFLIGHT_BUCKET_MASK     (GB_INFLIGHT_BUCKET_COUNT - 1)
 
 struct gb_cport_driver {
     struct gb_driver *driver;
     struct list_head tx_fifo;
+    struct list_head inflight[GB_INFLIGHT_BUCKET_COUNT];
     struct list_head rx_fifo;
     sem_t rx_fifo_lock;
+#ifdef CONFIG_GREYBUS_WORKER_POOL
+    struct list_head ready_list;
+    bool scheduled;
+#else
     pthread_t thread;
+#endif
     volatile bool exit_worker;
+    bool initialized;           /* driver init() has been called */
+#ifdef CONFIG_GREYBUS_LAZY_INIT
+    sem_t init_lock;            /* serializes the deferred driver init() */
+#endif
     struct wdog_s timeout_wd;
     struct gb_operation timedout_operation;
+    struct gb_transport_backend *transport; /* overrides the core backend */
+};
+
+#ifdef CONFIG_GREYBUS_WORKER_POOL
+struct gb_worker_pool {
+    struct list_head ready;
+    sem_t ready_lock;
+    volatile bool exit_worker;
+    pthread_t thread[CONFIG_GREYBUS_WORKER_POOL_SIZE];
 };
+#endif
 
 struct gb_tape_record_header {
     uint16_t size;
     uint16_t cport;
+    uint32_t timestamp; /* in us, from CLOCK_MONOTONIC */
+    uint8_t direction;  /* GB_TAPE_RX or GB_TAPE_TX */
+    uint8_t pad[3];
+};
+
+/*
+ * Tape records are queued by the RX and TX paths, possibly from interrupt
+ * context, and written to the tape by a background thread. Producers reserve
+ * and fill their space with interrupts disabled. The writer is the only one
+ * to move the tail, so it reads the records without any lock.
+ *
+ * The buffer only exists while recording. Producers check 'running' with
+ * interrupts disabled, so once gb_tape_stop() has cleared it, none of them
+ * can touch the buffer or the semaphore anymore.
+ */
+struct gb_tape_ring {
+    uint8_t *buf;
+    volatile bool running;
+    volatile size_t head;
+    volatile size_t tail;
+    sem_t pending;
+    pthread_t writer;
+    volatile bool exit_writer;
+    uint32_t dropped;
 };
 
 static unsigned int cport_count;
@@ -77,7 +134,16 @@ static struct gb_cport_driver *g_cport;
 static struct gb_bundle **g_bundle;
 static struct gb_transport_backend *transport_backend;
 static struct gb_tape_mechanism *gb_tape;
+#ifdef CONFIG_GREYBUS_WORKER_POOL
+static struct gb_worker_pool g_worker_pool;
+#endif
+#ifdef CONFIG_GREYBUS_OPERATION_POOL
+static struct gb_operation g_operation_pool[CONFIG_GREYBUS_OPERATION_POOL_SIZE];
+static struct list_head g_operation_pool_free;
+static struct gb_operation_pool_stats g_operation_pool_stats;
+#endif
 static int gb_tape_fd = -EBADFD;
+static struct gb_tape_ring gb_tape_ring;
 static struct gb_operation_hdr timedout_hdr = {
     .size = sizeof(timedout_hdr),
     .result = GB_OP_TIMEOUT,
@@ -154,6 +220,13 @@ static void op_mark_send_time(struct gb_operation *operation) { }
 static void op_mark_recv_time(struct gb_operation *operation) { }
 #endif
 
+static struct gb_transport_backend *gb_transport(unsigned int cport)
+{
+    if (g_cport[cport].transport)
+        return g_cport[cport].transport;
+    return transport_backend;
+}
+
 static int gb_compare_handlers(const void *data1, const void *data2)
 {
     const struct gb_operation_handler *handler1 = data1;
@@ -192,6 +265,44 @@ static struct gb_operation_handler *find_operation_handler(uint8_t type,
     return NULL;
 }
 
+/*
+ * Call the init() function of the driver of a cport, if not done yet.
+ * With CONFIG_GREYBUS_LAZY_INIT, this happens when the first request arrives
+ * on the cport or when the cport gets connected, rather than at registration.
+ * Both may happen at the same time from different threads, so the check and
+ * the init() call are done under the cport's init lock.
+ */
+static int gb_cport_driver_init(unsigned int cport)
+{
+    struct gb_driver *driver = g_cport[cport].driver;
+    int retval = 0;
+
+    if (g_cport[cport].initialized)
+        return 0;
+
+#ifdef CONFIG_GREYBUS_LAZY_INIT
+    while (sem_wait(&g_cport[cport].init_lock))
+        ;
+#endif
+
+    if (!g_cport[cport].initialized) {
+        if (driver->init) {
+            retval = driver->init(cport, driver->bundle);
+            if (retval)
+                gb_error("Can not init %s\n", gb_driver_name(driver));
+        }
+
+        if (!retval)
+            g_cport[cport].initialized = true;
+    }
+
+#ifdef CONFIG_GREYBUS_LAZY_INIT
+    sem_post(&g_cport[cport].init_lock);
+#endif
+
+    return retval;
+}
+
 static void gb_process_request(struct gb_operation_hdr *hdr,
                                struct gb_operation *operation)
 {
@@ -211,8 +322,25 @@ static void gb_process_request(struct gb_operation_hdr *hdr,
         return;
     }
 
+    if (gb_cport_driver_init(operation->cport)) {
+        gb_operation_send_response(operation, GB_OP_UNKNOWN_ERROR);
+        return;
+    }
+
     operation->bundle = g_cport[operation->cport].driver->bundle;
 
+    /*
+     * A request for a fast handler gets here if it arrived before the
+     * driver was initialized. Fast handlers send their own response and
+     * do not keep the message, which the operation still owns.
+     */
+    if (!op_handler->handler) {
+        if (op_handler->fast_handler)
+            op_handler->fast_handler(operation->cport,
+                                     operation->request_buffer);
+        return;
+    }
+
     result = op_handler->handler(operation);
     gb_debug("%s: %u\n", gb_handler_name(op_handler), result);
 
@@ -221,52 +349,118 @@ static void gb_process_request(struct gb_operation_hdr *hdr,
     op_mark_send_time(operation);
 }
 
-static bool gb_operation_has_timedout(struct gb_operation *operation)
+/*
+ * Number of ticks left before the deadline of the operation, negative or
+ * null once the operation has timed out. The difference is computed on the
+ * wrapped 32-bit tick counter.
+ */
+static int32_t gb_operation_time_left(struct gb_operation *operation)
 {
-    struct timespec current_time;
-    struct timespec timeout_time;
-
-    timeout_time.tv_sec = operation->time.tv_sec +
-                          TIMEOUT_IN_MS / ONE_SEC_IN_MSEC;
-    timeout_time.tv_nsec = operation->time.tv_nsec +
-                          (TIMEOUT_IN_MS % ONE_SEC_IN_MSEC) * ONE_MSEC_IN_NSEC;
-    clock_gettime(CLOCK_MONOTONIC, &current_time);
-
-    if (current_time.tv_sec > timeout_time.tv_sec)
-        return true;
-
-    if (current_time.tv_sec < timeout_time.tv_sec)
-        return false;
+    return (int32_t) (operation->deadline - (uint32_t) clock_systimer());
+}
 
-    return current_time.tv_nsec > timeout_time.tv_nsec;
+static bool gb_operation_has_timedout(struct gb_operation *operation)
+{
+    return gb_operation_time_left(operation) <= 0;
 }
 
 /**
  * Update watchdog state
  *
  * Cancel cport watchdog if there is no outgoing message waiting for a response,
- * or update the watchdog if there is still outgoing messages.
- *
- * TODO use fine-grain timeout delay when doing the update
+ * or arm the watchdog for the earliest deadline of the outgoing messages.
  *
  * @note This function should be called from an atomic context
  */
 static void gb_watchdog_update(unsigned int cport)
 {
     irqstate_t flags;
+    struct gb_operation *op;
+    int32_t delay;
 
     flags = irqsave();
 
     if (list_is_empty(&g_cport[cport].tx_fifo)) {
         wd_cancel(&g_cport[cport].timeout_wd);
     } else {
-        wd_start(&g_cport[cport].timeout_wd, TIMEOUT_WD_DELAY,
+        op = list_entry(g_cport[cport].tx_fifo.next, struct gb_operation, list);
+        delay = gb_operation_time_left(op);
+        wd_start(&g_cport[cport].timeout_wd, delay > 0 ? delay : 1,
                  gb_operation_timeout, 1, cport);
     }
 
     irqrestore(flags);
 }
 
+/**
+ * Track an outgoing operation until its response arrives
+ *
+ * The operation is inserted in the deadline-ordered tx_fifo of its cport, and
+ * hashed by the low bits of its operation id into the in-flight table so
+ * that the matching response can be found without walking the tx_fifo.
+ *
+ * Operations are usually sent with the same timeout, hence the insertion
+ * point is looked for from the tail of the tx_fifo.
+ *
+ * @note This function should be called from an atomic context
+ */
+static void gb_inflight_add(struct gb_operation *operation)
+{
+    struct gb_operation_hdr *hdr = operation->request_buffer;
+    struct gb_cport_driver *cport = &g_cport[operation->cport];
+    struct list_head *iter;
+    struct gb_operation *op;
+
+    list_reverse_foreach(&cport->tx_fifo, iter) {
+        op = list_entry(iter, struct gb_operation, list);
+        if ((int32_t) (operation->deadline - op->deadline) >= 0)
+            break;
+    }
+
+    /* insert right after iter, which may be the list head itself */
+    list_add(iter->next, &operation->list);
+    list_add(&cport->inflight[le16_to_cpu(hdr->id) & GB_INFLIGHT_BUCKET_MASK],
+             &operation->inflight_list);
+}
+
+/**
+ * @note This function should be called from an atomic context
+ */
+static void gb_inflight_del(struct gb_operation *operation)
+{
+    list_del(&operation->list);
+    list_del(&operation->inflight_list);
+}
+
+/**
+ * Find the outgoing operation waiting for the response with the given id
+ *
+ * Operation ids come from a single sequential counter, so the operations in
+ * flight on a cport spread evenly over the buckets and each bucket holds a
+ * handful of entries at most.
+ *
+ * @note This function should be called from an atomic context
+ */
+static struct gb_operation *gb_inflight_find(unsigned int cport, uint16_t id)
+{
+    struct list_head *bucket;
+    struct list_head *iter;
+    struct gb_operation *op;
+    struct gb_operation_hdr *op_hdr;
+
+    bucket = &g_cport[cport].inflight[le16_to_cpu(id) & GB_INFLIGHT_BUCKET_MASK];
+
+    list_foreach(bucket, iter) {
+        op = list_entry(iter, struct gb_operation, inflight_list);
+        op_hdr = op->request_buffer;
+
+        if (op_hdr->id == id)
+            return op;
+    }
+
+    return NULL;
+}
+
 static void gb_clean_timedout_operation(unsigned int cport)
 {
     irqstate_t flags;
@@ -276,12 +470,16 @@ static void gb_clean_timedout_operation(unsigned int cport)
     list_foreach_safe(&g_cport[cport].tx_fifo, iter, iter_next) {
         op = list_entry(iter, struct gb_operation, list);
 
+        /*
+         * The tx_fifo is sorted by deadline, so nothing past the first live
+         * operation has expired.
+         */
         if (!gb_operation_has_timedout(op)) {
-            continue;
+            break;
         }
 
         flags = irqsave();
-        list_del(iter);
+        gb_inflight_del(op);
         irqrestore(flags);
 
         if (op->callback) {
@@ -297,22 +495,17 @@ static void gb_process_response(struct gb_operation_hdr *hdr,
                                 struct gb_operation *operation)
 {
     irqstate_t flags;
-    struct list_head *iter, *iter_next;
     struct gb_operation *op;
-    struct gb_operation_hdr *op_hdr;
 
-    list_foreach_safe(&g_cport[operation->cport].tx_fifo, iter, iter_next) {
-        op = list_entry(iter, struct gb_operation, list);
-        op_hdr = op->request_buffer;
-
-        if (hdr->id != op_hdr->id)
-            continue;
-
-        flags = irqsave();
-        list_del(iter);
+    flags = irqsave();
+    op = gb_inflight_find(operation->cport, hdr->id);
+    if (op) {
+        gb_inflight_del(op);
         gb_watchdog_update(operation->cport);
-        irqrestore(flags);
+    }
+    irqrestore(flags);
 
+    if (op) {
         /* attach this response with the original request */
         gb_operation_ref(operation);
         op->response = operation;
@@ -323,84 +516,413 @@ static void gb_process_response(struct gb_operation_hdr *hdr,
         return;
     }
 
-    gb_error("CPort %u: cannot find matching request for response %hu. Dropping message.\n",
-             operation->cport, le16_to_cpu(hdr->id));
+    gb_error("CPort %u: cannot find matching request for response %hu. Dropping message.\n",
+             operation->cport, le16_to_cpu(hdr->id));
+}
+
+static void gb_process_message(unsigned int cportid)
+{
+    irqstate_t flags;
+    struct gb_operation *operation;
+    struct list_head *head;
+    struct gb_operation_hdr *hdr;
+
+    flags = irqsave();
+    head = g_cport[cportid].rx_fifo.next;
+    list_del(g_cport[cportid].rx_fifo.next);
+    irqrestore(flags);
+
+    operation = list_entry(head, struct gb_operation, list);
+    hdr = operation->request_buffer;
+
+    if (hdr == &timedout_hdr) {
+        gb_clean_timedout_operation(cportid);
+        return;
+    }
+
+    if (hdr->type & GB_TYPE_RESPONSE_FLAG)
+        gb_process_response(hdr, operation);
+    else
+        gb_process_request(hdr, operation);
+    gb_operation_destroy(operation);
+}
+
+#ifdef CONFIG_GREYBUS_WORKER_POOL
+/**
+ * Queue a cport in the ready list of the worker pool
+ *
+ * The ready list is sorted by driver priority, cports of the same priority
+ * being served in FIFO order. A cport is present at most once in the ready
+ * list and is only handled by one worker at a time, which preserves the
+ * ordering of the messages of a cport.
+ *
+ * @note This function should be called from an atomic context
+ */
+static void gb_worker_pool_schedule(unsigned int cportid)
+{
+    struct gb_cport_driver *cport = &g_cport[cportid];
+    struct gb_cport_driver *iter_cport;
+    struct list_head *iter;
+
+    list_reverse_foreach(&g_worker_pool.ready, iter) {
+        iter_cport = list_entry(iter, struct gb_cport_driver, ready_list);
+        if (iter_cport->driver->priority >= cport->driver->priority)
+            break;
+    }
+
+    list_add(iter->next, &cport->ready_list);
+    sem_post(&g_worker_pool.ready_lock);
+}
+
+static void *gb_pending_message_worker(void *data)
+{
+    irqstate_t flags;
+    struct gb_cport_driver *cport;
+    unsigned int cportid;
+    int retval;
+
+    while (1) {
+        retval = sem_wait(&g_worker_pool.ready_lock);
+        if (retval < 0)
+            continue;
+
+        if (g_worker_pool.exit_worker)
+            break;
+
+        flags = irqsave();
+        if (list_is_empty(&g_worker_pool.ready)) {
+            irqrestore(flags);
+            continue;
+        }
+
+        cport = list_entry(g_worker_pool.ready.next, struct gb_cport_driver,
+                           ready_list);
+        list_del(&cport->ready_list);
+        irqrestore(flags);
+
+        cportid = cport - g_cport;
+        gb_process_message(cportid);
+
+        flags = irqsave();
+        if (!list_is_empty(&cport->rx_fifo)) {
+            gb_worker_pool_schedule(cportid);
+        } else {
+            cport->scheduled = false;
+            if (cport->exit_worker)
+                sem_post(&cport->rx_fifo_lock);
+        }
+        irqrestore(flags);
+    }
+
+    return NULL;
+}
+
+static int gb_worker_pool_start(void)
+{
+    pthread_attr_t thread_attr;
+    int retval;
+    int i;
+
+    list_init(&g_worker_pool.ready);
+    sem_init(&g_worker_pool.ready_lock, 0, 0);
+    g_worker_pool.exit_worker = false;
+
+    retval = pthread_attr_init(&thread_attr);
+    if (retval)
+        return -retval;
+
+    retval = pthread_attr_setstacksize(&thread_attr,
+                                       CONFIG_GREYBUS_WORKER_POOL_STACK_SIZE);
+    if (retval)
+        goto out;
+
+    for (i = 0; i < CONFIG_GREYBUS_WORKER_POOL_SIZE; i++) {
+        retval = pthread_create(&g_worker_pool.thread[i], &thread_attr,
+                                gb_pending_message_worker, NULL);
+        if (retval) {
+            gb_error("Can not create greybus worker %d\n", i);
+            break;
+        }
+    }
+
+out:
+    pthread_attr_destroy(&thread_attr);
+    return -retval;
+}
+
+static void gb_worker_pool_stop(void)
+{
+    int i;
+
+    g_worker_pool.exit_worker = true;
+
+    for (i = 0; i < CONFIG_GREYBUS_WORKER_POOL_SIZE; i++)
+        sem_post(&g_worker_pool.ready_lock);
+
+    for (i = 0; i < CONFIG_GREYBUS_WORKER_POOL_SIZE; i++) {
+        if (g_worker_pool.thread[i])
+            pthread_join(g_worker_pool.thread[i], NULL);
+    }
+
+    sem_destroy(&g_worker_pool.ready_lock);
+}
+
+/**
+ * Hand a message over to the worker pool
+ *
+ * @note This function should be called from an atomic context
+ */
+static void gb_rx_fifo_push(unsigned int cportid, struct gb_operation *op)
+{
+    list_add(&g_cport[cportid].rx_fifo, &op->list);
+
+    if (!g_cport[cportid].scheduled) {
+        g_cport[cportid].scheduled = true;
+        gb_worker_pool_schedule(cportid);
+    }
+}
+
+static int gb_cport_worker_start(unsigned int cport, struct gb_driver *driver)
+{
+    g_cport[cport].scheduled = false;
+    return 0;
+}
+
+/*
+ * Wait for the worker pool to be done with the messages already queued on
+ * the cport.
+ */
+static void gb_cport_worker_stop(unsigned int cport)
+{
+    irqstate_t flags;
+    bool scheduled;
+    int retval;
+
+    flags = irqsave();
+    g_cport[cport].exit_worker = true;
+    scheduled = g_cport[cport].scheduled;
+    irqrestore(flags);
+
+    if (!scheduled)
+        return;
+
+    do {
+        retval = sem_wait(&g_cport[cport].rx_fifo_lock);
+    } while (retval < 0 && errno == EINTR);
+}
+#else
+static void *gb_pending_message_worker(void *data)
+{
+    const int cportid = (int) data;
+    int retval;
+
+    while (1) {
+        retval = sem_wait(&g_cport[cportid].rx_fifo_lock);
+        if (retval < 0)
+            continue;
+
+        if (g_cport[cportid].exit_worker &&
+            list_is_empty(&g_cport[cportid].rx_fifo)) {
+            break;
+        }
+
+        gb_process_message(cportid);
+    }
+
+    return NULL;
+}
+
+/**
+ * Hand a message over to the cport worker
+ *
+ * @note This function should be called from an atomic context
+ */
+static void gb_rx_fifo_push(unsigned int cportid, struct gb_operation *op)
+{
+    list_add(&g_cport[cportid].rx_fifo, &op->list);
+    sem_post(&g_cport[cportid].rx_fifo_lock);
+}
+
+static int gb_cport_worker_start(unsigned int cport, struct gb_driver *driver)
+{
+    pthread_attr_t thread_attr;
+    int retval;
+
+    if (!driver->stack_size)
+        driver->stack_size = DEFAULT_STACK_SIZE;
+
+    retval = pthread_attr_init(&thread_attr);
+    if (retval)
+        return retval;
+
+    retval = pthread_attr_setstacksize(&thread_attr, driver->stack_size);
+    if (retval)
+        goto out;
+
+    retval = pthread_create(&g_cport[cport].thread, &thread_attr,
+                            gb_pending_message_worker, (unsigned*) cport);
+
+out:
+    pthread_attr_destroy(&thread_attr);
+    return retval;
+}
+
+static void gb_cport_worker_stop(unsigned int cport)
+{
+    g_cport[cport].exit_worker = true;
+    sem_post(&g_cport[cport].rx_fifo_lock);
+    pthread_join(g_cport[cport].thread, NULL);
+}
+#endif
+
+static struct gb_operation *gb_rx_create_operation(unsigned cport, void *data,
+                                                   size_t size, bool copy)
+{
+    struct gb_operation *op;
+
+#if defined(CONFIG_UNIPRO_ZERO_COPY)
+    if (!copy) {
+        op = _gb_operation_create(cport);
+        if (!op)
+            return NULL;
+
+        op->is_unipro_rx_buf = true;
+        op->request_buffer = data;
+
+        return op;
+    }
+#endif
+
+    op = gb_operation_create(cport, 0, size - sizeof(struct gb_operation_hdr));
+    if (!op)
+        return NULL;
+
+    memcpy(op->request_buffer, data, size);
+
+    return op;
+}
+
+static void gb_tape_ring_copy_in(size_t pos, const void *data, size_t size)
+{
+    size_t offset = pos & GB_TAPE_BUFFER_MASK;
+    size_t chunk = MIN(size, CONFIG_GREYBUS_TAPE_BUFFER_SIZE - offset);
+
+    memcpy(&gb_tape_ring.buf[offset], data, chunk);
+    memcpy(gb_tape_ring.buf, (const uint8_t *) data + chunk, size - chunk);
+}
+
+static void gb_tape_ring_copy_out(size_t pos, void *data, size_t size)
+{
+    size_t offset = pos & GB_TAPE_BUFFER_MASK;
+    size_t chunk = MIN(size, CONFIG_GREYBUS_TAPE_BUFFER_SIZE - offset);
+
+    memcpy(data, &gb_tape_ring.buf[offset], chunk);
+    memcpy((uint8_t *) data + chunk, gb_tape_ring.buf, size - chunk);
+}
+
+static void gb_tape_ring_write_out(int fd, size_t pos, size_t size)
+{
+    size_t offset = pos & GB_TAPE_BUFFER_MASK;
+    size_t chunk = MIN(size, CONFIG_GREYBUS_TAPE_BUFFER_SIZE - offset);
+
+    gb_tape->write(fd, &gb_tape_ring.buf[offset], chunk);
+    if (size > chunk)
+        gb_tape->write(fd, gb_tape_ring.buf, size - chunk);
 }
 
-static void *gb_pending_message_worker(void *data)
+static uint32_t gb_tape_timestamp(void)
 {
-    const int cportid = (int) data;
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * USEC_PER_SEC + ts.tv_nsec / NSEC_PER_USEC;
+}
+
+/*
+ * Queue a message for the tape. The record is dropped if the ring does not
+ * have enough room left.
+ *
+ * Every message sent or received goes through here, so this is also where
+ * messages are added to the scheduler trace.
+ */
+static void gb_tape_record(unsigned int cport, const void *data, size_t size,
+                           uint8_t direction)
+{
+    struct gb_tape_record_header record_hdr;
     irqstate_t flags;
-    struct gb_operation *operation;
-    struct list_head *head;
-    struct gb_operation_hdr *hdr;
-    int retval;
+    size_t head;
+#ifdef CONFIG_SCHED_TRACE
+    const struct gb_operation_hdr *hdr = data;
+
+    sched_trace(direction == GB_TAPE_RX ? SCHED_TRACE_GB_RX :
+                                          SCHED_TRACE_GB_TX,
+                hdr->type, cport,
+                le16_to_cpu(hdr->id) | (uint32_t) hdr->result << 16);
+#endif
 
-    while (1) {
-        retval = sem_wait(&g_cport[cportid].rx_fifo_lock);
-        if (retval < 0)
-            continue;
+    if (!gb_tape_ring.running)
+        return;
 
-        if (g_cport[cportid].exit_worker &&
-            list_is_empty(&g_cport[cportid].rx_fifo)) {
-            break;
-        }
+    record_hdr.size = size;
+    record_hdr.cport = cport;
+    record_hdr.timestamp = gb_tape_timestamp();
+    record_hdr.direction = direction;
+    memset(record_hdr.pad, 0, sizeof(record_hdr.pad));
 
-        flags = irqsave();
-        head = g_cport[cportid].rx_fifo.next;
-        list_del(g_cport[cportid].rx_fifo.next);
+    flags = irqsave();
+
+    /* gb_tape_stop() may have run since the check above */
+    if (!gb_tape_ring.running) {
         irqrestore(flags);
+        return;
+    }
 
-        operation = list_entry(head, struct gb_operation, list);
-        hdr = operation->request_buffer;
+    head = gb_tape_ring.head;
+    if (CONFIG_GREYBUS_TAPE_BUFFER_SIZE - (head - gb_tape_ring.tail) <
+        sizeof(record_hdr) + size) {
+        gb_tape_ring.dropped++;
+        irqrestore(flags);
+        return;
+    }
 
-        if (hdr == &timedout_hdr) {
-            gb_clean_timedout_operation(cportid);
-            continue;
-        }
+    gb_tape_ring_copy_in(head, &record_hdr, sizeof(record_hdr));
+    gb_tape_ring_copy_in(head + sizeof(record_hdr), data, size);
+    gb_tape_ring.head = head + sizeof(record_hdr) + size;
 
-        if (hdr->type & GB_TYPE_RESPONSE_FLAG)
-            gb_process_response(hdr, operation);
-        else
-            gb_process_request(hdr, operation);
-        gb_operation_destroy(operation);
-    }
+    sem_post(&gb_tape_ring.pending);
 
-    return NULL;
+    irqrestore(flags);
 }
 
-#if defined(CONFIG_UNIPRO_ZERO_COPY)
-static struct gb_operation *gb_rx_create_operation(unsigned cport, void *data,
-                                                   size_t size)
+static void *gb_tape_writer(void *data)
 {
-    struct gb_operation *op;
+    struct gb_tape_record_header record_hdr;
+    int fd = (int) data;
+    size_t tail;
 
-    op = _gb_operation_create(cport);
-    if (!op)
-        return NULL;
-
-    op->is_unipro_rx_buf = true;
-    op->request_buffer = data;
+    while (1) {
+        sem_wait(&gb_tape_ring.pending);
 
-    return op;
-}
-#else
-static struct gb_operation *gb_rx_create_operation(unsigned cport, void *data,
-                                                   size_t size)
-{
-    struct gb_operation *op;
+        tail = gb_tape_ring.tail;
+        while (tail != gb_tape_ring.head) {
+            gb_tape_ring_copy_out(tail, &record_hdr, sizeof(record_hdr));
+            gb_tape->write(fd, &record_hdr, sizeof(record_hdr));
+            gb_tape_ring_write_out(fd, tail + sizeof(record_hdr),
+                                   record_hdr.size);
 
-    op = gb_operation_create(cport, 0, size - sizeof(struct gb_operation_hdr));
-    if (!op)
-        return NULL;
+            tail += sizeof(record_hdr) + record_hdr.size;
+            gb_tape_ring.tail = tail;
+        }
 
-    memcpy(op->request_buffer, data, size);
+        if (gb_tape_ring.exit_writer)
+            break;
+    }
 
-    return op;
+    return NULL;
 }
-#endif
 
-int greybus_rx_handler(unsigned int cport, void *data, size_t size)
+static int gb_rx_handler(unsigned int cport, void *data, size_t size,
+                         bool copy)
 {
     irqstate_t flags;
     struct gb_operation *op;
@@ -433,37 +955,42 @@ int greybus_rx_handler(unsigned int cport, void *data, size_t size)
 
     gb_dump(data, size);
 
-    if (gb_tape && gb_tape_fd >= 0) {
-        struct gb_tape_record_header record_hdr = {
-            .size = size,
-            .cport = cport,
-        };
-
-        gb_tape->write(gb_tape_fd, &record_hdr, sizeof(record_hdr));
-        gb_tape->write(gb_tape_fd, data, size);
-    }
+    gb_tape_record(cport, data, size, GB_TAPE_RX);
 
     op_handler = find_operation_handler(hdr->type, cport);
-    if (op_handler && op_handler->fast_handler) {
+    if (op_handler && op_handler->fast_handler && g_cport[cport].initialized) {
         gb_debug("%s\n", gb_handler_name(op_handler));
         op_handler->fast_handler(cport, data);
+#if defined(CONFIG_UNIPRO_ZERO_COPY)
+        if (!copy)
+            unipro_rxbuf_free(cport, data);
+#endif
         return 0;
     }
 
-    op = gb_rx_create_operation(cport, data, hdr_size);
+    op = gb_rx_create_operation(cport, data, hdr_size, copy);
     if (!op)
         return -ENOMEM;
 
     op_mark_recv_time(op);
 
     flags = irqsave();
-    list_add(&g_cport[cport].rx_fifo, &op->list);
-    sem_post(&g_cport[cport].rx_fifo_lock);
+    gb_rx_fifo_push(cport, op);
     irqrestore(flags);
 
     return 0;
 }
 
+int greybus_rx_handler(unsigned int cport, void *data, size_t size)
+{
+    return gb_rx_handler(cport, data, size, false);
+}
+
+int gb_rx_handler_copy(unsigned int cport, const void *data, size_t size)
+{
+    return gb_rx_handler(cport, (void *) data, size, true);
+}
+
 static void gb_flush_tx_fifo(unsigned int cport)
 {
     struct list_head *iter, *iter_next;
@@ -471,7 +998,7 @@ static void gb_flush_tx_fifo(unsigned int cport)
     list_foreach_safe(&g_cport[cport].tx_fifo, iter, iter_next) {
         struct gb_operation *op = list_entry(iter, struct gb_operation, list);
 
-        list_del(iter);
+        gb_inflight_del(op);
         gb_operation_unref(op);
     }
 }
@@ -481,19 +1008,18 @@ int gb_unregister_driver(unsigned int cport)
     if (cport >= cport_count || !g_cport[cport].driver || !transport_backend)
         return -EINVAL;
 
-    if (transport_backend->stop_listening)
-        transport_backend->stop_listening(cport);
+    if (gb_transport(cport)->stop_listening)
+        gb_transport(cport)->stop_listening(cport);
 
     wd_cancel(&g_cport[cport].timeout_wd);
 
-    g_cport[cport].exit_worker = true;
-    sem_post(&g_cport[cport].rx_fifo_lock);
-    pthread_join(g_cport[cport].thread, NULL);
+    gb_cport_worker_stop(cport);
 
     gb_flush_tx_fifo(cport);
 
-    if (g_cport[cport].driver->exit)
+    if (g_cport[cport].initialized && g_cport[cport].driver->exit)
         g_cport[cport].driver->exit(cport, g_cport[cport].driver->bundle);
+    g_cport[cport].initialized = false;
     g_cport[cport].driver = NULL;
 
     return 0;
@@ -502,8 +1028,6 @@ int gb_unregister_driver(unsigned int cport)
 int _gb_register_driver(unsigned int cport, int bundle_id,
                         struct gb_driver *driver)
 {
-    pthread_attr_t thread_attr;
-    pthread_attr_t *thread_attr_ptr = &thread_attr;
     struct gb_bundle *bundle;
     int retval;
 
@@ -558,6 +1082,9 @@ int _gb_register_driver(unsigned int cport, int bundle_id,
 
     driver->bundle = bundle;
 
+#ifdef CONFIG_GREYBUS_LAZY_INIT
+    g_cport[cport].initialized = false;
+#else
     if (driver->init) {
         retval = driver->init(cport, bundle);
         if (retval) {
@@ -566,6 +1093,9 @@ int _gb_register_driver(unsigned int cport, int bundle_id,
         }
     }
 
+    g_cport[cport].initialized = true;
+#endif
+
     if (driver->op_handlers) {
         qsort(driver->op_handlers, driver->op_handlers_count,
               sizeof(*driver->op_handlers), gb_compare_handlers);
@@ -573,40 +1103,39 @@ int _gb_register_driver(unsigned int cport, int bundle_id,
 
     g_cport[cport].exit_worker = false;
 
-    if (!driver->stack_size)
-        driver->stack_size = DEFAULT_STACK_SIZE;
-
-    retval = pthread_attr_init(&thread_attr);
-    if (retval)
-        goto pthread_attr_init_error;
-
-    retval = pthread_attr_setstacksize(&thread_attr, driver->stack_size);
-    if (retval)
-        goto pthread_attr_setstacksize_error;
-
-    retval = pthread_create(&g_cport[cport].thread, &thread_attr,
-                            gb_pending_message_worker, (unsigned*) cport);
+    retval = gb_cport_worker_start(cport, driver);
     if (retval)
-        goto pthread_create_error;
-
-    pthread_attr_destroy(&thread_attr);
-    thread_attr_ptr = NULL;
+        goto worker_start_error;
 
     g_cport[cport].driver = driver;
 
     return 0;
 
-pthread_create_error:
-pthread_attr_setstacksize_error:
-    if (thread_attr_ptr != NULL)
-        pthread_attr_destroy(&thread_attr);
-pthread_attr_init_error:
+worker_start_error:
     gb_error("Can not create thread for %s\n: ", gb_driver_name(driver));
-    if (driver->exit)
+    if (g_cport[cport].initialized && driver->exit)
         driver->exit(cport, bundle);
+    g_cport[cport].initialized = false;
     return retval;
 }
 
+int gb_set_transport(unsigned int cport,
+                     struct gb_transport_backend *transport)
+{
+    if (cport >= cport_count) {
+        gb_error("Invalid cport number %u\n", cport);
+        return -EINVAL;
+    }
+
+    if (g_cport[cport].driver) {
+        gb_error("Cport %u already has a driver registered\n", cport);
+        return -EBUSY;
+    }
+
+    g_cport[cport].transport = transport;
+    return 0;
+}
+
 int gb_listen(unsigned int cport)
 {
     DEBUGASSERT(transport_backend);
@@ -622,7 +1151,7 @@ int gb_listen(unsigned int cport)
         return -EINVAL;
     }
 
-    return transport_backend->listen(cport);
+    return gb_transport(cport)->listen(cport);
 }
 
 int gb_stop_listening(unsigned int cport)
@@ -641,7 +1170,7 @@ int gb_stop_listening(unsigned int cport)
         return -EINVAL;
     }
 
-    return transport_backend->stop_listening(cport);
+    return gb_transport(cport)->stop_listening(cport);
 }
 
 static void gb_operation_timeout(int argc, uint32_t cport, ...)
@@ -656,8 +1185,7 @@ static void gb_operation_timeout(int argc, uint32_t cport, ...)
         return;
     }
 
-    list_add(&g_cport[cport].rx_fifo, &g_cport[cport].timedout_operation.list);
-    sem_post(&g_cport[cport].rx_fifo_lock);
+    gb_rx_fifo_push(cport, &g_cport[cport].timedout_operation);
     irqrestore(flags);
 }
 
@@ -683,17 +1211,20 @@ int gb_operation_send_request_nowait(struct gb_operation *operation,
                                      bool need_response)
 {
     struct gb_operation_hdr *hdr = operation->request_buffer;
+    struct gb_transport_backend *transport;
     int retval = 0;
     irqstate_t flags;
 
     DEBUGASSERT(operation);
     DEBUGASSERT(transport_backend);
-    DEBUGASSERT(transport_backend->send_async);
 
     if (g_cport[operation->cport].exit_worker) {
         return -ENETDOWN;
     }
 
+    transport = gb_transport(operation->cport);
+    DEBUGASSERT(transport->send_async);
+
     if (need_response) {
         return -ENOTSUP;
     }
@@ -702,26 +1233,30 @@ int gb_operation_send_request_nowait(struct gb_operation *operation,
     operation->callback = callback;
 
     gb_dump(operation->request_buffer, hdr->size);
+    gb_tape_record(operation->cport, operation->request_buffer,
+                   le16_to_cpu(hdr->size), GB_TAPE_TX);
 
     gb_operation_ref(operation);
 
     flags = irqsave();
-    retval = transport_backend->send_async(operation->cport,
-                                           operation->request_buffer,
-                                           le16_to_cpu(hdr->size),
-                                           gb_operation_send_request_nowait_cb,
-                                           operation);
+    retval = transport->send_async(operation->cport,
+                                   operation->request_buffer,
+                                   le16_to_cpu(hdr->size),
+                                   gb_operation_send_request_nowait_cb,
+                                   operation);
     op_mark_send_time(operation);
     irqrestore(flags);
 
     return retval;
 }
 
-int gb_operation_send_request(struct gb_operation *operation,
-                              gb_operation_callback callback,
-                              bool need_response)
+static int _gb_operation_send_request(struct gb_operation *operation,
+                                      gb_operation_callback callback,
+                                      bool need_response,
+                                      unsigned int timeout_ms)
 {
     struct gb_operation_hdr *hdr = operation->request_buffer;
+    struct gb_cport_driver *cport = &g_cport[operation->cport];
     int retval = 0;
     irqstate_t flags;
 
@@ -740,23 +1275,26 @@ int gb_operation_send_request(struct gb_operation *operation,
         hdr->id = cpu_to_le16(atomic_inc(&request_id));
         if (hdr->id == 0) /* ID 0 is for request with no response */
             hdr->id = cpu_to_le16(atomic_inc(&request_id));
-        clock_gettime(CLOCK_MONOTONIC, &operation->time);
+        operation->deadline = (uint32_t) clock_systimer() +
+                              MSEC2TICK(timeout_ms);
         operation->callback = callback;
         gb_operation_ref(operation);
-        list_add(&g_cport[operation->cport].tx_fifo, &operation->list);
-        if (!WDOG_ISACTIVE(&g_cport[operation->cport].timeout_wd)) {
-            wd_start(&g_cport[operation->cport].timeout_wd, TIMEOUT_WD_DELAY,
-                     gb_operation_timeout, 1, operation->cport);
-        }
+        gb_inflight_add(operation);
+
+        /* re-arm the watchdog if this is now the earliest deadline */
+        if (cport->tx_fifo.next == &operation->list)
+            gb_watchdog_update(operation->cport);
     }
 
     gb_dump(operation->request_buffer, hdr->size);
-    retval = transport_backend->send(operation->cport,
-                                     operation->request_buffer,
-                                     le16_to_cpu(hdr->size));
+    gb_tape_record(operation->cport, operation->request_buffer,
+                   le16_to_cpu(hdr->size), GB_TAPE_TX);
+    retval = gb_transport(operation->cport)->send(operation->cport,
+                                operation->request_buffer,
+                                le16_to_cpu(hdr->size));
     op_mark_send_time(operation);
     if (need_response && retval) {
-        list_del(&operation->list);
+        gb_inflight_del(operation);
         gb_watchdog_update(operation->cport);
         gb_operation_unref(operation);
     }
@@ -766,6 +1304,24 @@ int gb_operation_send_request(struct gb_operation *operation,
     return retval;
 }
 
+int gb_operation_send_request(struct gb_operation *operation,
+                              gb_operation_callback callback,
+                              bool need_response)
+{
+    return _gb_operation_send_request(operation, callback, need_response,
+                                      TIMEOUT_IN_MS);
+}
+
+int gb_operation_send_request_timeout(struct gb_operation *operation,
+                                      gb_operation_callback callback,
+                                      unsigned int timeout_ms)
+{
+    if (!timeout_ms)
+        return -EINVAL;
+
+    return _gb_operation_send_request(operation, callback, true, timeout_ms);
+}
+
 static void gb_operation_callback_sync(struct gb_operation *operation)
 {
     sem_post(&operation->sync_sem);
@@ -802,9 +1358,10 @@ static int gb_operation_send_oom_response(struct gb_operation *operation)
 
     oom_hdr.id = req_hdr->id;
     oom_hdr.type = GB_TYPE_RESPONSE_FLAG | req_hdr->type;
+    gb_tape_record(operation->cport, &oom_hdr, sizeof(oom_hdr), GB_TAPE_TX);
 
-    retval = transport_backend->send(operation->cport, &oom_hdr,
-                                     sizeof(oom_hdr));
+    retval = gb_transport(operation->cport)->send(operation->cport,
+                                &oom_hdr, sizeof(oom_hdr));
 
     irqrestore(flags);
 
@@ -813,6 +1370,7 @@ static int gb_operation_send_oom_response(struct gb_operation *operation)
 
 int gb_operation_send_response(struct gb_operation *operation, uint8_t result)
 {
+    struct gb_transport_backend *transport;
     struct gb_operation_hdr *resp_hdr;
     int retval;
     bool has_allocated_response = false;
@@ -824,6 +1382,8 @@ int gb_operation_send_response(struct gb_operation *operation, uint8_t result)
     if (g_cport[operation->cport].exit_worker)
         return -ENETDOWN;
 
+    transport = gb_transport(operation->cport);
+
     if (operation->has_responded)
         return -EINVAL;
 
@@ -840,14 +1400,15 @@ int gb_operation_send_response(struct gb_operation *operation, uint8_t result)
 
     gb_dump(operation->response_buffer, resp_hdr->size);
     gb_loopback_log_exit(operation->cport, operation, resp_hdr->size);
-    retval = transport_backend->send(operation->cport,
-                                     operation->response_buffer,
-                                     le16_to_cpu(resp_hdr->size));
+    gb_tape_record(operation->cport, operation->response_buffer,
+                   le16_to_cpu(resp_hdr->size), GB_TAPE_TX);
+    retval = transport->send(operation->cport, operation->response_buffer,
+                             le16_to_cpu(resp_hdr->size));
     if (retval) {
         gb_error("Greybus backend failed to send: error %d\n", retval);
         if (has_allocated_response) {
             gb_debug("Free the response buffer\n");
-            transport_backend->free_buf(operation->response_buffer);
+            transport->free_buf(operation->response_buffer);
             operation->response_buffer = NULL;
         }
         return retval;
@@ -865,7 +1426,7 @@ void *gb_operation_alloc_response(struct gb_operation *operation, size_t size)
     DEBUGASSERT(operation);
 
     operation->response_buffer =
-        transport_backend->alloc_buf(size + sizeof(*resp_hdr));
+        gb_transport(operation->cport)->alloc_buf(size + sizeof(*resp_hdr));
     if (!operation->response_buffer) {
         gb_error("Can not allocate a response_buffer\n");
         return NULL;
@@ -882,6 +1443,42 @@ void *gb_operation_alloc_response(struct gb_operation *operation, size_t size)
     return gb_operation_get_response_payload(operation);
 }
 
+/**
+ * Allocate the response of an operation in its request buffer
+ *
+ * When the request buffer is large enough to hold the response, the response
+ * is built in place and no buffer is allocated. The response header is
+ * written over the request header, and the response payload overlaps the
+ * request payload, so the handler must be done reading any request field it
+ * writes the response over. Unlike gb_operation_alloc_response(), the
+ * payload is not cleared. Falls back to gb_operation_alloc_response() when
+ * the response does not fit.
+ */
+void *gb_operation_alloc_response_in_place(struct gb_operation *operation,
+                                           size_t size)
+{
+    struct gb_operation_hdr *hdr;
+    size_t capacity;
+
+    DEBUGASSERT(operation);
+
+    hdr = operation->request_buffer;
+    capacity = operation->is_unipro_rx_buf ? CPORT_BUF_SIZE :
+                                             le16_to_cpu(hdr->size);
+
+    if (size + sizeof(*hdr) > capacity)
+        return gb_operation_alloc_response(operation, size);
+
+    operation->response_buffer = operation->request_buffer;
+
+    hdr->size = cpu_to_le16(size + sizeof(*hdr));
+    hdr->type |= GB_TYPE_RESPONSE_FLAG;
+    hdr->result = 0;
+    memset(hdr->pad, 0, sizeof(hdr->pad));
+
+    return gb_operation_get_response_payload(operation);
+}
+
 void gb_operation_destroy(struct gb_operation *operation)
 {
     DEBUGASSERT(operation);
@@ -895,6 +1492,96 @@ void gb_operation_ref(struct gb_operation *operation)
     atomic_inc(&operation->ref_count);
 }
 
+#ifdef CONFIG_GREYBUS_OPERATION_POOL
+static void gb_operation_pool_init(void)
+{
+    int i;
+
+    list_init(&g_operation_pool_free);
+    for (i = 0; i < CONFIG_GREYBUS_OPERATION_POOL_SIZE; i++)
+        list_add(&g_operation_pool_free, &g_operation_pool[i].list);
+
+    memset(&g_operation_pool_stats, 0, sizeof(g_operation_pool_stats));
+    g_operation_pool_stats.size = CONFIG_GREYBUS_OPERATION_POOL_SIZE;
+}
+
+/*
+ * Operations are taken from a preallocated pool with interrupts disabled,
+ * hence without the heap semaphore, so that they can be created from the
+ * UniPro RX interrupt. Once the pool is exhausted, operations are allocated
+ * from the heap unless we are in interrupt context.
+ */
+static struct gb_operation *gb_operation_alloc(void)
+{
+    struct gb_operation *operation = NULL;
+    irqstate_t flags;
+
+    flags = irqsave();
+    if (!list_is_empty(&g_operation_pool_free)) {
+        operation = list_entry(g_operation_pool_free.next,
+                               struct gb_operation, list);
+        list_del(&operation->list);
+
+        g_operation_pool_stats.in_use++;
+        if (g_operation_pool_stats.in_use > g_operation_pool_stats.high_water)
+            g_operation_pool_stats.high_water = g_operation_pool_stats.in_use;
+    } else {
+        g_operation_pool_stats.fallbacks++;
+    }
+    irqrestore(flags);
+
+    if (!operation && !up_interrupt_context())
+        operation = malloc(sizeof(*operation));
+
+    return operation;
+}
+
+static void gb_operation_free(struct gb_operation *operation)
+{
+    irqstate_t flags;
+
+    if (operation < g_operation_pool ||
+        operation >= &g_operation_pool[CONFIG_GREYBUS_OPERATION_POOL_SIZE]) {
+        free(operation);
+        return;
+    }
+
+    flags = irqsave();
+    list_add(&g_operation_pool_free, &operation->list);
+    g_operation_pool_stats.in_use--;
+    irqrestore(flags);
+}
+
+int gb_operation_get_pool_stats(struct gb_operation_pool_stats *stats)
+{
+    irqstate_t flags;
+
+    if (!stats)
+        return -EINVAL;
+
+    flags = irqsave();
+    memcpy(stats, &g_operation_pool_stats, sizeof(*stats));
+    irqrestore(flags);
+
+    return 0;
+}
+#else
+static struct gb_operation *gb_operation_alloc(void)
+{
+    return malloc(sizeof(struct gb_operation));
+}
+
+static void gb_operation_free(struct gb_operation *operation)
+{
+    free(operation);
+}
+
+int gb_operation_get_pool_stats(struct gb_operation_pool_stats *stats)
+{
+    return -ENOSYS;
+}
+#endif
+
 void gb_operation_unref(struct gb_operation *operation)
 {
     DEBUGASSERT(operation);
@@ -908,14 +1595,15 @@ void gb_operation_unref(struct gb_operation *operation)
     if (operation->is_unipro_rx_buf) {
         unipro_rxbuf_free(operation->cport, operation->request_buffer);
     } else {
-        transport_backend->free_buf(operation->request_buffer);
+        gb_transport(operation->cport)->free_buf(operation->request_buffer);
     }
 
-    transport_backend->free_buf(operation->response_buffer);
+    if (operation->response_buffer != operation->request_buffer)
+        gb_transport(operation->cport)->free_buf(operation->response_buffer);
     if (operation->response) {
         gb_operation_unref(operation->response);
     }
-    free(operation);
+    gb_operation_free(operation);
 }
 
 static struct gb_operation *_gb_operation_create(unsigned int cport)
@@ -925,7 +1613,7 @@ static struct gb_operation *_gb_operation_create(unsigned int cport)
     if (cport >= cport_count)
         return NULL;
 
-    operation = malloc(sizeof(*operation));
+    operation = gb_operation_alloc();
     if (!operation)
         return NULL;
 
@@ -933,6 +1621,7 @@ static struct gb_operation *_gb_operation_create(unsigned int cport)
     operation->cport = cport;
 
     list_init(&operation->list);
+    list_init(&operation->inflight_list);
     atomic_init(&operation->ref_count, 1);
 
     return operation;
@@ -953,7 +1642,7 @@ struct gb_operation *gb_operation_create(unsigned int cport, uint8_t type,
     }
 
     operation->request_buffer =
-        transport_backend->alloc_buf(req_size + sizeof(*hdr));
+        gb_transport(cport)->alloc_buf(req_size + sizeof(*hdr));
     if (!operation->request_buffer)
         goto malloc_error;
 
@@ -964,7 +1653,7 @@ struct gb_operation *gb_operation_create(unsigned int cport, uint8_t type,
 
     return operation;
 malloc_error:
-    free(operation);
+    gb_operation_free(operation);
     return NULL;
 }
 
@@ -1017,10 +1706,14 @@ int gb_init(struct gb_transport_backend *transport)
 {
     size_t num_bundles = manifest_get_max_bundle_id() + 1;
     int i;
+    int j;
 
     if (!transport)
         return -EINVAL;
 
+    if (transport_backend)
+        return -EALREADY;
+
     g_bundle = zalloc(sizeof(struct gb_bundle *) * num_bundles);
     if (!g_bundle) {
         return -ENOMEM;
@@ -1035,8 +1728,13 @@ int gb_init(struct gb_transport_backend *transport)
 
     for (i = 0; i < cport_count; i++) {
         sem_init(&g_cport[i].rx_fifo_lock, 0, 0);
+#ifdef CONFIG_GREYBUS_LAZY_INIT
+        sem_init(&g_cport[i].init_lock, 0, 1);
+#endif
         list_init(&g_cport[i].rx_fifo);
         list_init(&g_cport[i].tx_fifo);
+        for (j = 0; j < GB_INFLIGHT_BUCKET_COUNT; j++)
+            list_init(&g_cport[i].inflight[j]);
         wd_static(&g_cport[i].timeout_wd);
         g_cport[i].timedout_operation.request_buffer = &timedout_hdr;
         list_init(&g_cport[i].timedout_operation.list);
@@ -1044,6 +1742,19 @@ int gb_init(struct gb_transport_backend *transport)
 
     atomic_init(&request_id, (uint32_t) 0);
 
+#ifdef CONFIG_GREYBUS_OPERATION_POOL
+    gb_operation_pool_init();
+#endif
+
+#ifdef CONFIG_GREYBUS_WORKER_POOL
+    if (gb_worker_pool_start()) {
+        gb_worker_pool_stop();
+        free(g_cport);
+        free(g_bundle);
+        return -ENOMEM;
+    }
+#endif
+
     transport_backend = transport;
     transport_backend->init();
 
@@ -1062,8 +1773,15 @@ void gb_deinit(void)
 
         wd_delete(&g_cport[i].timeout_wd);
         sem_destroy(&g_cport[i].rx_fifo_lock);
+#ifdef CONFIG_GREYBUS_LAZY_INIT
+        sem_destroy(&g_cport[i].init_lock);
+#endif
     }
 
+#ifdef CONFIG_GREYBUS_WORKER_POOL
+    gb_worker_pool_stop();
+#endif
+
     free(g_cport);
 
     if (transport_backend->exit)
@@ -1087,33 +1805,110 @@ int gb_tape_register_mechanism(struct gb_tape_mechanism *mechanism)
 
 int gb_tape_communication(const char *pathname)
 {
+    pthread_attr_t thread_attr;
+    int retval;
+    int fd;
+
+    DEBUGASSERT(!(CONFIG_GREYBUS_TAPE_BUFFER_SIZE & GB_TAPE_BUFFER_MASK));
+
     if (!gb_tape)
         return -EINVAL;
 
     if (gb_tape_fd >= 0)
         return -EBUSY;
 
-    gb_tape_fd = gb_tape->open(pathname, GB_TAPE_WRONLY);
-    if (gb_tape_fd < 0)
-        return gb_tape_fd;
+    gb_tape_ring.buf = malloc(CONFIG_GREYBUS_TAPE_BUFFER_SIZE);
+    if (!gb_tape_ring.buf)
+        return -ENOMEM;
+
+    fd = gb_tape->open(pathname, GB_TAPE_WRONLY);
+    if (fd < 0) {
+        retval = fd;
+        goto error_open;
+    }
+
+    gb_tape_ring.head = 0;
+    gb_tape_ring.tail = 0;
+    gb_tape_ring.dropped = 0;
+    gb_tape_ring.exit_writer = false;
+    sem_init(&gb_tape_ring.pending, 0, 0);
+
+    retval = pthread_attr_init(&thread_attr);
+    if (retval)
+        goto error_attr_init;
+
+    retval = pthread_attr_setstacksize(&thread_attr, DEFAULT_STACK_SIZE);
+    if (retval)
+        goto error_thread_create;
+
+    retval = pthread_create(&gb_tape_ring.writer, &thread_attr,
+                            gb_tape_writer, (void *) fd);
+    if (retval)
+        goto error_thread_create;
+
+    pthread_attr_destroy(&thread_attr);
+
+    /* start recording only once the writer is running */
+    gb_tape_fd = fd;
+    gb_tape_ring.running = true;
 
     return 0;
+
+error_thread_create:
+    pthread_attr_destroy(&thread_attr);
+error_attr_init:
+    sem_destroy(&gb_tape_ring.pending);
+    gb_tape->close(fd);
+    retval = -retval;
+error_open:
+    free(gb_tape_ring.buf);
+    gb_tape_ring.buf = NULL;
+    return retval;
 }
 
 int gb_tape_stop(void)
 {
-    if (!gb_tape || gb_tape_fd < 0)
+    irqstate_t flags;
+    int fd = gb_tape_fd;
+
+    if (!gb_tape || fd < 0)
         return -EINVAL;
 
-    gb_tape->close(gb_tape_fd);
+    /* stop queuing records, then let the writer drain the ring */
+    flags = irqsave();
+    gb_tape_ring.running = false;
+    irqrestore(flags);
+
     gb_tape_fd = -EBADFD;
 
+    gb_tape_ring.exit_writer = true;
+    sem_post(&gb_tape_ring.pending);
+    pthread_join(gb_tape_ring.writer, NULL);
+    sem_destroy(&gb_tape_ring.pending);
+
+    free(gb_tape_ring.buf);
+    gb_tape_ring.buf = NULL;
+
+    if (gb_tape_ring.dropped)
+        gb_error("gb-tape: %u records dropped\n", gb_tape_ring.dropped);
+
+    gb_tape->close(fd);
+
     return 0;
 }
 
-int gb_tape_replay(const char *pathname)
+uint32_t gb_tape_get_dropped_count(void)
+{
+    return gb_tape_ring.dropped;
+}
+
+int gb_tape_replay(const char *pathname, enum gb_tape_replay_mode mode)
 {
     struct gb_tape_record_header hdr;
+    uint32_t tape_start = 0;
+    uint32_t replay_start = 0;
+    uint32_t elapsed;
+    bool started = false;
     char *buffer;
     ssize_t nread;
     int retval = 0;
@@ -1139,7 +1934,7 @@ int gb_tape_replay(const char *pathname)
         if (!nread)
             break;
 
-        if (nread != sizeof(hdr)) {
+        if (nread != sizeof(hdr) || hdr.size > CPORT_BUF_SIZE) {
             gb_error("gb-tape: invalid byte count read, aborting...\n");
             retval = -EIO;
             break;
@@ -1152,7 +1947,24 @@ int gb_tape_replay(const char *pathname)
             break;
         }
 
-        greybus_rx_handler(hdr.cport, buffer, nread);
+        /* messages we sent are recorded for analysis only */
+        if (hdr.direction != GB_TAPE_RX)
+            continue;
+
+        if (mode == GB_TAPE_REPLAY_PACED) {
+            if (!started) {
+                tape_start = hdr.timestamp;
+                replay_start = gb_tape_timestamp();
+                started = true;
+            }
+
+            elapsed = gb_tape_timestamp() - replay_start;
+            if (hdr.timestamp - tape_start > elapsed)
+                usleep(hdr.timestamp - tape_start - elapsed);
+        }
+
+        /* the buffer is reused for the next record, so the core copies it */
+        gb_rx_handler_copy(hdr.cport, buffer, nread);
     }
 
     free(buffer);
@@ -1173,12 +1985,15 @@ int gb_notify(unsigned cport, enum gb_event event)
 
     switch (event) {
     case GB_EVT_CONNECTED:
+        if (gb_cport_driver_init(cport))
+            return -EIO;
+
         if (g_cport[cport].driver->connected)
             g_cport[cport].driver->connected(cport);
         break;
 
     case GB_EVT_DISCONNECTED:
-        if (g_cport[cport].driver->disconnected)
+        if (g_cport[cport].initialized && g_cport[cport].driver->disconnected)
             g_cport[cport].driver->disconnected(cport);
         break;
 
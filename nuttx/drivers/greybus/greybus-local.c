@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2015 Google Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+
+#include <nuttx/arch.h>
+#include <nuttx/greybus/debug.h>
+#include <nuttx/greybus/greybus.h>
+#include <nuttx/greybus/local.h>
+
+#include <arch/atomic.h>
+
+static gb_local_peer_rx_t gb_local_peer;
+static atomic_t gb_local_alloc_count;
+static atomic_t gb_local_tx_count;
+static atomic_t gb_local_rx_count;
+
+static void gb_local_backend_init(void)
+{
+    atomic_init(&gb_local_alloc_count, 0);
+    atomic_init(&gb_local_tx_count, 0);
+    atomic_init(&gb_local_rx_count, 0);
+}
+
+static int gb_local_listen(unsigned int cport)
+{
+    return 0;
+}
+
+static int gb_local_stop_listening(unsigned int cport)
+{
+    return 0;
+}
+
+static int gb_local_send(unsigned int cport, const void *buf, size_t len)
+{
+    if (!gb_local_peer)
+        return -ENOTCONN;
+
+    atomic_inc(&gb_local_tx_count);
+    gb_local_peer(cport, buf, len);
+
+    return 0;
+}
+
+static int gb_local_send_async(unsigned int cport, const void *buf,
+                               size_t len, unipro_send_completion_t callback,
+                               void *priv)
+{
+    int retval;
+
+    retval = gb_local_send(cport, buf, len);
+    if (retval)
+        return retval;
+
+    if (callback)
+        callback(0, buf, priv);
+
+    return 0;
+}
+
+static void *gb_local_alloc_buf(size_t size)
+{
+    atomic_inc(&gb_local_alloc_count);
+    return malloc(size);
+}
+
+static struct gb_transport_backend gb_local_backend = {
+    .init = gb_local_backend_init,
+    .send = gb_local_send,
+    .send_async = gb_local_send_async,
+    .listen = gb_local_listen,
+    .stop_listening = gb_local_stop_listening,
+    .alloc_buf = gb_local_alloc_buf,
+    .free_buf = free,
+};
+
+/**
+ * Feed a message to the Greybus core as if it was received on a cport
+ *
+ * The message is copied by the core, so the buffer can be reused as soon as
+ * this function returns.
+ */
+int gb_local_inject(unsigned int cport, const void *data, size_t size)
+{
+    atomic_inc(&gb_local_rx_count);
+    return gb_rx_handler_copy(cport, data, size);
+}
+
+void gb_local_get_stats(struct gb_local_stats *stats)
+{
+    DEBUGASSERT(stats);
+
+    stats->alloc_count = atomic_get(&gb_local_alloc_count);
+    stats->tx_count = atomic_get(&gb_local_tx_count);
+    stats->rx_count = atomic_get(&gb_local_rx_count);
+}
+
+/**
+ * Route a cport through the local backend
+ *
+ * If the Greybus core is not running yet, it is started with the local
+ * backend. Otherwise, only @cport is switched to the local backend and the
+ * other cports keep using the transport the core was started with.
+ */
+int gb_local_init(unsigned int cport, gb_local_peer_rx_t peer)
+{
+    int retval;
+
+    gb_debug("Greybus: register local backend on cport %u\n", cport);
+
+    gb_local_peer = peer;
+
+    retval = gb_init(&gb_local_backend);
+    if (retval == -EALREADY)
+        gb_local_backend_init();
+    else if (retval)
+        return retval;
+
+    return gb_set_transport(cport, &gb_local_backend);
+}
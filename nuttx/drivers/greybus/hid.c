@@ -36,6 +36,7 @@
 #include <nuttx/device_hid.h>
 #include <nuttx/greybus/greybus.h>
 #include <apps/greybus-utils/utils.h>
+#include <apps/greybus-utils/greybus_manifest.h>
 
 #include <arch/byteorder.h>
 
@@ -763,3 +764,4 @@ void gb_hid_register(int cport, int bundle)
 {
     gb_register_driver(cport, bundle, &gb_hid_driver);
 }
+GB_PROTOCOL_DRIVER(hid, GREYBUS_PROTOCOL_HID, gb_hid_register);
@@ -35,6 +35,7 @@
 #include <nuttx/device_i2c.h>
 #include <nuttx/greybus/greybus.h>
 #include <nuttx/greybus/debug.h>
+#include <apps/greybus-utils/greybus_manifest.h>
 
 #include "i2c-gb.h"
 
@@ -187,4 +188,5 @@ void gb_i2c_register(int cport, int bundle)
 {
     gb_register_driver(cport, bundle, &gb_i2c_driver);
 }
+GB_PROTOCOL_DRIVER(i2c, GREYBUS_PROTOCOL_I2C, gb_i2c_register);
 
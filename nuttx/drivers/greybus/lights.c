@@ -36,6 +36,7 @@
 #include <nuttx/greybus/greybus.h>
 #include <nuttx/greybus/debug.h>
 #include <apps/greybus-utils/utils.h>
+#include <apps/greybus-utils/greybus_manifest.h>
 #include <arch/byteorder.h>
 
 #include "lights-gb.h"
@@ -696,3 +697,4 @@ void gb_lights_register(int cport, int bundle)
 {
     gb_register_driver(cport, bundle, &gb_lights_driver);
 }
+GB_PROTOCOL_DRIVER(lights, GREYBUS_PROTOCOL_LIGHTS, gb_lights_register);
@@ -40,17 +40,41 @@
 #include <nuttx/greybus/debug.h>
 #include <nuttx/time.h>
 #include <nuttx/util.h>
+#include <apps/greybus-utils/greybus_manifest.h>
 #include <arch/byteorder.h>
 
 #define GB_LOOPBACK_VERSION_MAJOR 0
 #define GB_LOOPBACK_VERSION_MINOR 1
 
+/*
+ * Latencies are recorded in a log-linear histogram: values below
+ * 2^SUB_BITS us get one bucket each, and every power of two above is split
+ * in 2^SUB_BITS buckets of equal width, which bounds the error of the
+ * reported percentiles to 1/2^SUB_BITS. Latencies of 2^MAX_BITS us and
+ * above all land in the last bucket.
+ */
+#define GB_LOOPBACK_HIST_SUB_BITS       3
+#define GB_LOOPBACK_HIST_MAX_BITS       24
+#define GB_LOOPBACK_HIST_SUB_COUNT      (1 << GB_LOOPBACK_HIST_SUB_BITS)
+#define GB_LOOPBACK_HIST_BUCKET_COUNT \
+    ((GB_LOOPBACK_HIST_MAX_BITS - GB_LOOPBACK_HIST_SUB_BITS + 1) << \
+     GB_LOOPBACK_HIST_SUB_BITS)
+
+struct gb_loopback_accumulator {
+    unsigned samples;
+    uint64_t latency_sum;
+    uint64_t throughput_sum;
+    uint64_t reqs_per_sec_sum;
+    uint32_t latency_hist[GB_LOOPBACK_HIST_BUCKET_COUNT];
+};
+
 struct gb_loopback {
     struct list_head list;
     pthread_mutex_t lock;
     int cport;
     struct gb_timestamp ts;
     struct gb_loopback_statistics stats;
+    struct gb_loopback_accumulator acc;
 };
 
 struct list_head gb_loopback_list = LIST_INIT(gb_loopback_list);
@@ -114,6 +138,64 @@ static struct gb_loopback *loopback_from_cport(int cport)
     return NULL;
 }
 
+static unsigned latency_to_bucket(unsigned latency)
+{
+    unsigned shift;
+
+    if (latency < GB_LOOPBACK_HIST_SUB_COUNT)
+        return latency;
+
+    if (latency >= 1 << GB_LOOPBACK_HIST_MAX_BITS)
+        return GB_LOOPBACK_HIST_BUCKET_COUNT - 1;
+
+    shift = 31 - __builtin_clz(latency) - GB_LOOPBACK_HIST_SUB_BITS;
+    return ((shift + 1) << GB_LOOPBACK_HIST_SUB_BITS) +
+           (latency >> shift) - GB_LOOPBACK_HIST_SUB_COUNT;
+}
+
+/* Highest latency that falls into the given bucket */
+static unsigned bucket_to_latency(unsigned bucket)
+{
+    unsigned shift;
+    unsigned sub;
+
+    if (bucket < GB_LOOPBACK_HIST_SUB_COUNT)
+        return bucket;
+
+    shift = (bucket >> GB_LOOPBACK_HIST_SUB_BITS) - 1;
+    sub = bucket & (GB_LOOPBACK_HIST_SUB_COUNT - 1);
+
+    return ((GB_LOOPBACK_HIST_SUB_COUNT + sub + 1) << shift) - 1;
+}
+
+/*
+ * Latency below which the given fraction, in units of 1/1000, of the
+ * samples fall. Never reports more than the largest latency seen.
+ */
+static unsigned latency_percentile(struct gb_loopback *loopback,
+                                   unsigned permille)
+{
+    struct gb_loopback_accumulator *acc = &loopback->acc;
+    uint64_t target;
+    uint64_t count = 0;
+    unsigned latency;
+    int i;
+
+    if (!acc->samples)
+        return 0;
+
+    target = ((uint64_t) acc->samples * permille + 999) / 1000;
+
+    for (i = 0; i < GB_LOOPBACK_HIST_BUCKET_COUNT; i++) {
+        count += acc->latency_hist[i];
+        if (count >= target)
+            break;
+    }
+
+    latency = bucket_to_latency(i);
+    return MIN(latency, loopback->stats.latency_max);
+}
+
 /**
  * @brief Get loopback stats for given cport
  * @param cport cport number
@@ -131,6 +213,10 @@ int gb_loopback_get_stats(int cport, struct gb_loopback_statistics *stats)
 
     loopback_lock(loopback);
     memcpy(stats, &loopback->stats, sizeof(struct gb_loopback_statistics));
+    stats->latency_p50 = latency_percentile(loopback, 500);
+    stats->latency_p90 = latency_percentile(loopback, 900);
+    stats->latency_p99 = latency_percentile(loopback, 990);
+    stats->latency_p999 = latency_percentile(loopback, 999);
     loopback_unlock(loopback);
 
     return 0;
@@ -169,6 +255,7 @@ void gb_loopback_reset(int cport)
     if (loopback != NULL) {
         loopback_lock(loopback);
         memset(&loopback->stats, 0, sizeof(struct gb_loopback_statistics));
+        memset(&loopback->acc, 0, sizeof(struct gb_loopback_accumulator));
         loopback_unlock(loopback);
     }
 }
@@ -191,6 +278,7 @@ int gb_loopback_cport_valid(int cport)
 static void update_loopback_stats(struct gb_operation *operation, int xfer)
 {
     struct gb_loopback_transfer_request *request;
+    struct gb_loopback_accumulator *acc;
     struct gb_loopback_statistics *stats;
     struct gb_loopback *loopback;
     struct timespec ts_total;
@@ -200,6 +288,8 @@ static void update_loopback_stats(struct gb_operation *operation, int xfer)
 
     timespecsub(&operation->recv_ts, &operation->send_ts, &ts_total);
     total = timespec_to_usec(&ts_total);
+    if (!total)
+        total = 1; /* below the timer resolution */
 
     loopback = loopback_from_cport(operation->cport);
     if (!loopback) {
@@ -211,40 +301,37 @@ static void update_loopback_stats(struct gb_operation *operation, int xfer)
     tps = tpr * DIV_ROUND_CLOSEST(USEC_PER_SEC, total);
     rps = DIV_ROUND_CLOSEST(USEC_PER_SEC, total);
     stats = &loopback->stats;
+    acc = &loopback->acc;
 
-#define UPDATE_AVG(avg, new)                                            \
-    do {                                                                \
-        if ((avg) == 0)                                                 \
-            (avg) = (new);                                              \
-        else                                                            \
-            (avg) = DIV_ROUND_CLOSEST((avg) + (new), 2);                \
-    } while (0)
+    acc->samples++;
+    acc->latency_sum += total;
+    acc->throughput_sum += tps;
+    acc->reqs_per_sec_sum += rps;
+    acc->latency_hist[latency_to_bucket(total)]++;
 
-#define UPDATE_MIN(min, avg)                                            \
+#define UPDATE_MIN(min, new)                                            \
     do {                                                                \
-        if ((min) == 0)                                                 \
-            (min) = (avg);                                              \
-        else if ((avg) < (min))                                         \
-            (min) = (avg);                                              \
+        if (acc->samples == 1 || (new) < (min))                         \
+            (min) = (new);                                              \
     } while (0)
 
-#define UPDATE_MAX(max, avg)                                            \
+#define UPDATE_MAX(max, new)                                            \
     do {                                                                \
-        if ((avg) > (max))                                              \
-            (max) = (avg);                                              \
+        if ((new) > (max))                                              \
+            (max) = (new);                                              \
     } while (0)
 
-    UPDATE_AVG(stats->latency_avg, total);
-    UPDATE_AVG(stats->throughput_avg, tps);
-    UPDATE_AVG(stats->reqs_per_sec_avg, rps);
-    UPDATE_MIN(stats->latency_min, stats->latency_avg);
-    UPDATE_MIN(stats->throughput_min, stats->throughput_avg);
-    UPDATE_MIN(stats->reqs_per_sec_min, stats->reqs_per_sec_avg);
-    UPDATE_MAX(stats->latency_max, stats->latency_avg);
-    UPDATE_MAX(stats->throughput_max, stats->throughput_avg);
-    UPDATE_MAX(stats->reqs_per_sec_max, stats->reqs_per_sec_avg);
-
-#undef UPDATE_AVG
+    UPDATE_MIN(stats->latency_min, total);
+    UPDATE_MIN(stats->throughput_min, tps);
+    UPDATE_MIN(stats->reqs_per_sec_min, rps);
+    UPDATE_MAX(stats->latency_max, total);
+    UPDATE_MAX(stats->throughput_max, tps);
+    UPDATE_MAX(stats->reqs_per_sec_max, rps);
+
+    stats->latency_avg = acc->latency_sum / acc->samples;
+    stats->throughput_avg = acc->throughput_sum / acc->samples;
+    stats->reqs_per_sec_avg = acc->reqs_per_sec_sum / acc->samples;
+
 #undef UPDATE_MIN
 #undef UPDATE_MAX
 }
@@ -385,12 +472,22 @@ static uint8_t gb_loopback_transfer_req_cb(struct gb_operation *operation)
 
     request_length = le32_to_cpu(request->len);
 
-    response = gb_operation_alloc_response(operation,
-                                           sizeof(*response) + request_length);
+    /*
+     * Request and response share the same layout, so when the response is
+     * built in the request buffer the data is already where it belongs.
+     */
+    response = gb_operation_alloc_response_in_place(operation,
+                                        sizeof(*response) + request_length);
     if(!response)
         return GB_OP_NO_MEMORY;
-    response->len = request->len;
-    memcpy(response->data, request->data, request_length);
+
+    if ((void *) response != (void *) request) {
+        response->len = request->len;
+        memcpy(response->data, request->data, request_length);
+    }
+
+    response->reserved0 = 0;
+    response->reserved1 = 0;
     return GB_OP_SUCCESS;
 }
 
@@ -454,3 +551,4 @@ void gb_loopback_register(int cport, int bundle)
     gb_timestamp_init();
     gb_register_driver(cport, bundle, &loopback_driver);
 }
+GB_PROTOCOL_DRIVER(loopback, GREYBUS_PROTOCOL_LOOPBACK, gb_loopback_register);
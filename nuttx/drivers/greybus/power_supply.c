@@ -37,6 +37,7 @@
 
 #include "power_supply-gb.h"
 #include <nuttx/device_power_supply.h>
+#include <apps/greybus-utils/greybus_manifest.h>
 
 /* Version of the Greybus power supply protocol we support */
 #define GB_POWER_SUPPLY_VERSION_MAJOR 0x00
@@ -443,3 +444,5 @@ void gb_power_supply_register(int cport, int bundle)
 {
     gb_register_driver(cport, bundle, &gb_power_supply_driver);
 }
+GB_PROTOCOL_DRIVER(power_supply, GREYBUS_PROTOCOL_POWER_SUPPLY,
+                   gb_power_supply_register);
@@ -37,6 +37,7 @@
 #include <nuttx/greybus/debug.h>
 #include <arch/byteorder.h>
 #include <apps/greybus-utils/utils.h>
+#include <apps/greybus-utils/greybus_manifest.h>
 
 #include "pwm-gb.h"
 
@@ -530,3 +531,4 @@ void gb_pwm_register(int cport, int bundle)
 {
     gb_register_driver(cport, bundle, &gb_pwm_driver);
 }
+GB_PROTOCOL_DRIVER(pwm, GREYBUS_PROTOCOL_PWM, gb_pwm_register);
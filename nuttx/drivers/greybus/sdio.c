@@ -36,6 +36,7 @@
 #include <nuttx/device_sdio.h>
 #include <nuttx/greybus/greybus.h>
 #include <apps/greybus-utils/utils.h>
+#include <apps/greybus-utils/greybus_manifest.h>
 
 #include <arch/byteorder.h>
 
@@ -475,3 +476,4 @@ void gb_sdio_register(int cport, int bundle)
 {
     gb_register_driver(cport, bundle, &sdio_driver);
 }
+GB_PROTOCOL_DRIVER(sdio, GREYBUS_PROTOCOL_SDIO, gb_sdio_register);
@@ -36,6 +36,7 @@
 #include <nuttx/greybus/greybus.h>
 #include <nuttx/greybus/debug.h>
 #include <apps/greybus-utils/utils.h>
+#include <apps/greybus-utils/greybus_manifest.h>
 
 #include <arch/byteorder.h>
 
@@ -357,4 +358,5 @@ void gb_spi_register(int cport, int bundle)
 {
     gb_register_driver(cport, bundle, &gb_spi_driver);
 }
+GB_PROTOCOL_DRIVER(spi, GREYBUS_PROTOCOL_SPI, gb_spi_register);
 
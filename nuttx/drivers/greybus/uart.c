@@ -42,6 +42,7 @@
 #include <nuttx/greybus/debug.h>
 #include <nuttx/unipro/unipro.h>
 #include <apps/greybus-utils/utils.h>
+#include <apps/greybus-utils/greybus_manifest.h>
 #include <arch/byteorder.h>
 
 #include "uart-gb.h"
@@ -988,4 +989,5 @@ void gb_uart_register(int cport, int bundle)
     gb_info("%s(): cport %d bundle %d\n", __func__, cport, bundle);
     gb_register_driver(cport, bundle, &uart_driver);
 }
+GB_PROTOCOL_DRIVER(uart, GREYBUS_PROTOCOL_UART, gb_uart_register);
 
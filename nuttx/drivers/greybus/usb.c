@@ -31,6 +31,7 @@
 #include <arch/byteorder.h>
 #include <nuttx/greybus/greybus.h>
 #include <nuttx/usb.h>
+#include <apps/greybus-utils/greybus_manifest.h>
 #include "usb-gb.h"
 
 #include <stdio.h>
@@ -156,3 +157,4 @@ void gb_usb_register(int cport, int bundle)
 {
     gb_register_driver(cport, bundle, &usb_driver);
 }
+GB_PROTOCOL_DRIVER(usb, GREYBUS_PROTOCOL_USB, gb_usb_register);
@@ -35,6 +35,7 @@
 #include <nuttx/greybus/debug.h>
 #include <apps/greybus-utils/utils.h>
 #include <nuttx/gpio.h>
+#include <apps/greybus-utils/greybus_manifest.h>
 #include <arch/byteorder.h>
 
 #include "vibrator-gb.h"
@@ -107,3 +108,4 @@ void gb_vibrator_register(int cport, int bundle)
 {
     gb_register_driver(cport, bundle, &gb_vibrator_driver);
 }
+GB_PROTOCOL_DRIVER(vibrator, GREYBUS_PROTOCOL_VIBRATOR, gb_vibrator_register);
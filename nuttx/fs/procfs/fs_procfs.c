@@ -78,6 +78,12 @@
 extern const struct procfs_operations proc_operations;
 extern const struct procfs_operations cpuload_operations;
 extern const struct procfs_operations uptime_operations;
+#if defined(CONFIG_MM_PROFILE) && !defined(CONFIG_FS_PROCFS_EXCLUDE_HEAPPROF)
+extern const struct procfs_operations heapprof_operations;
+#endif
+#if defined(CONFIG_SCHED_TRACE) && !defined(CONFIG_FS_PROCFS_EXCLUDE_TRACE)
+extern const struct procfs_operations trace_operations;
+#endif
 
 /* This is not good.  These are implemented in drivers/mtd.  Having to
  * deal with them here is not a good coupling.
@@ -112,6 +118,14 @@ static const struct procfs_entry_s g_procfsentries[] =
   { "cpuload",          &cpuload_operations },
 #endif
 
+#if defined(CONFIG_MM_PROFILE) && !defined(CONFIG_FS_PROCFS_EXCLUDE_HEAPPROF)
+  { "heapprof",         &heapprof_operations },
+#endif
+
+#if defined(CONFIG_SCHED_TRACE) && !defined(CONFIG_FS_PROCFS_EXCLUDE_TRACE)
+  { "trace",            &trace_operations },
+#endif
+
 #if defined(CONFIG_FS_SMARTFS) && !defined(CONFIG_FS_PROCFS_EXCLUDE_SMARTFS)
 //{ "fs/smartfs",       &smartfs_procfsoperations },
   { "fs/smartfs**",     &smartfs_procfsoperations },
@@ -0,0 +1,412 @@
+/****************************************************************************
+ * fs/procfs/fs_procfsheapprof.c
+ *
+ * Copyright (c) 2015 Google Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <assert.h>
+#include <errno.h>
+#include <debug.h>
+
+#include <nuttx/kmalloc.h>
+#include <nuttx/mm/mm.h>
+#include <nuttx/fs/fs.h>
+#include <nuttx/fs/procfs.h>
+
+#if !defined(CONFIG_DISABLE_MOUNTPOINT) && defined(CONFIG_FS_PROCFS)
+#if defined(CONFIG_MM_PROFILE) && !defined(CONFIG_FS_PROCFS_EXCLUDE_HEAPPROF)
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+/* Determines the size of an intermediate buffer that must be large enough
+ * to handle the longest line generated by this logic.
+ */
+
+#define HEAPPROF_LINELEN (64 + CONFIG_TASK_NAME_SIZE)
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+/* This structure describes one open "file" */
+
+struct heapprof_file_s
+{
+  struct procfs_file_s base;         /* Base open file structure */
+  struct mm_profile_s profile;       /* Snapshot taken at f_pos 0 */
+  char line[HEAPPROF_LINELEN];       /* Pre-allocated buffer for formatted lines */
+};
+
+/* State of one read() */
+
+struct heapprof_read_s
+{
+  FAR char *buffer;                  /* Where to copy the next line */
+  size_t remaining;                  /* Space left in the user buffer */
+  size_t totalsize;                  /* Bytes copied so far */
+  off_t offset;                      /* Bytes still to be skipped */
+};
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+/* File system methods */
+
+static int     heapprof_open(FAR struct file *filep, FAR const char *relpath,
+                 int oflags, mode_t mode);
+static int     heapprof_close(FAR struct file *filep);
+static ssize_t heapprof_read(FAR struct file *filep, FAR char *buffer,
+                 size_t buflen);
+
+static int     heapprof_dup(FAR const struct file *oldp,
+                 FAR struct file *newp);
+
+static int     heapprof_stat(FAR const char *relpath, FAR struct stat *buf);
+
+/****************************************************************************
+ * Public Variables
+ ****************************************************************************/
+
+/* See fs_mount.c -- this structure is explicitly externed there.
+ * We use the old-fashioned kind of initializers so that this will compile
+ * with any compiler.
+ */
+
+const struct procfs_operations heapprof_operations =
+{
+  heapprof_open,     /* open */
+  heapprof_close,    /* close */
+  heapprof_read,     /* read */
+  NULL,              /* write */
+
+  heapprof_dup,      /* dup */
+
+  NULL,              /* opendir */
+  NULL,              /* closedir */
+  NULL,              /* readdir */
+  NULL,              /* rewinddir */
+
+  heapprof_stat      /* stat */
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: heapprof_emit
+ *
+ * Description:
+ *   Transfer one formatted line to the user buffer.
+ *
+ ****************************************************************************/
+
+static void heapprof_emit(FAR struct heapprof_file_s *attr,
+                          FAR struct heapprof_read_s *rd, int linesize)
+{
+  size_t copysize;
+
+  if (linesize >= HEAPPROF_LINELEN)
+    {
+      linesize = HEAPPROF_LINELEN - 1;
+    }
+
+  copysize       = procfs_memcpy(attr->line, linesize, rd->buffer,
+                                 rd->remaining, &rd->offset);
+  rd->totalsize += copysize;
+  rd->buffer    += copysize;
+  rd->remaining -= copysize;
+}
+
+static void heapprof_count(FAR struct heapprof_file_s *attr,
+                           FAR struct heapprof_read_s *rd,
+                           FAR const char *label,
+                           FAR const struct mm_profcount_s *count)
+{
+  int linesize;
+
+  linesize = snprintf(attr->line, HEAPPROF_LINELEN,
+                      "%-*s %9lu %9lu %9lu %9lu\n",
+                      CONFIG_TASK_NAME_SIZE + 12, label,
+                      (unsigned long)count->live, (unsigned long)count->peak,
+                      (unsigned long)count->nallocs,
+                      (unsigned long)count->nfrees);
+  heapprof_emit(attr, rd, linesize);
+}
+
+/****************************************************************************
+ * Name: heapprof_open
+ ****************************************************************************/
+
+static int heapprof_open(FAR struct file *filep, FAR const char *relpath,
+                         int oflags, mode_t mode)
+{
+  FAR struct heapprof_file_s *attr;
+
+  fvdbg("Open '%s'\n", relpath);
+
+  /* PROCFS is read-only.  Any attempt to open with any kind of write
+   * access is not permitted.
+   */
+
+  if ((oflags & O_WRONLY) != 0 || (oflags & O_RDONLY) == 0)
+    {
+      fdbg("ERROR: Only O_RDONLY supported\n");
+      return -EACCES;
+    }
+
+  /* "heapprof" is the only acceptable value for the relpath */
+
+  if (strcmp(relpath, "heapprof") != 0)
+    {
+      fdbg("ERROR: relpath is '%s'\n", relpath);
+      return -ENOENT;
+    }
+
+  /* Allocate a container to hold the file attributes */
+
+  attr = (FAR struct heapprof_file_s *)
+    kmm_zalloc(sizeof(struct heapprof_file_s));
+  if (!attr)
+    {
+      fdbg("ERROR: Failed to allocate file attributes\n");
+      return -ENOMEM;
+    }
+
+  /* Save the attributes as the open-specific state in filep->f_priv */
+
+  filep->f_priv = (FAR void *)attr;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: heapprof_close
+ ****************************************************************************/
+
+static int heapprof_close(FAR struct file *filep)
+{
+  FAR struct heapprof_file_s *attr;
+
+  /* Recover our private data from the struct file instance */
+
+  attr = (FAR struct heapprof_file_s *)filep->f_priv;
+  DEBUGASSERT(attr);
+
+  /* Release the file attributes structure */
+
+  kmm_free(attr);
+  filep->f_priv = NULL;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: heapprof_read
+ ****************************************************************************/
+
+static ssize_t heapprof_read(FAR struct file *filep, FAR char *buffer,
+                             size_t buflen)
+{
+  FAR struct heapprof_file_s *attr;
+  FAR struct mm_profile_s *prof;
+  struct heapprof_read_s rd;
+  char label[CONFIG_TASK_NAME_SIZE + 16];
+  int linesize;
+  int i;
+
+  fvdbg("buffer=%p buflen=%d\n", buffer, (int)buflen);
+
+  /* Recover our private data from the struct file instance */
+
+  attr = (FAR struct heapprof_file_s *)filep->f_priv;
+  DEBUGASSERT(attr);
+  prof = &attr->profile;
+
+  /* If f_pos is zero, then take a snapshot of the profile.  Otherwise,
+   * keep on using the snapshot taken by the first read() so that the
+   * output remains stable throughout the reads.
+   */
+
+  if (filep->f_pos == 0)
+    {
+      mm_profile_snapshot(&g_mmheap, prof);
+    }
+
+  rd.buffer    = buffer;
+  rd.remaining = buflen;
+  rd.totalsize = 0;
+  rd.offset    = filep->f_pos;
+
+  /* Heap totals */
+
+  linesize = snprintf(attr->line, HEAPPROF_LINELEN,
+                      "Live: %lu bytes, peak: %lu bytes\n\n",
+                      (unsigned long)prof->live, (unsigned long)prof->peak);
+  heapprof_emit(attr, &rd, linesize);
+
+  /* One line per task */
+
+  linesize = snprintf(attr->line, HEAPPROF_LINELEN, "%-*s %9s %9s %9s %9s\n",
+                      CONFIG_TASK_NAME_SIZE + 12, "PID   NAME", "LIVE",
+                      "PEAK", "ALLOCS", "FREES");
+  heapprof_emit(attr, &rd, linesize);
+
+  for (i = 0; i < prof->ntasks && rd.remaining > 0; i++)
+    {
+#if CONFIG_TASK_NAME_SIZE > 0
+      snprintf(label, sizeof(label), "%5d %s", prof->task[i].pid,
+               prof->task[i].name);
+#else
+      snprintf(label, sizeof(label), "%5d", prof->task[i].pid);
+#endif
+      heapprof_count(attr, &rd, label, &prof->task[i].count);
+    }
+
+  if (prof->task[CONFIG_MM_PROFILE_NTASKS].count.nallocs > 0)
+    {
+      heapprof_count(attr, &rd, "    - (other)",
+                     &prof->task[CONFIG_MM_PROFILE_NTASKS].count);
+    }
+
+  /* One line per call site */
+
+  linesize = snprintf(attr->line, HEAPPROF_LINELEN, "\n%-*s %9s %9s %9s %9s\n",
+                      CONFIG_TASK_NAME_SIZE + 12, "CALLER", "LIVE",
+                      "PEAK", "ALLOCS", "FREES");
+  heapprof_emit(attr, &rd, linesize);
+
+  for (i = 0; i < prof->nsites && rd.remaining > 0; i++)
+    {
+      /* Skip the entries released by the allocators themselves, whose
+       * allocations were all moved to their own callers.
+       */
+
+      if (prof->site[i].caller == NULL)
+        {
+          continue;
+        }
+
+      snprintf(label, sizeof(label), "%p", prof->site[i].caller);
+      heapprof_count(attr, &rd, label, &prof->site[i].count);
+    }
+
+  if (prof->site[CONFIG_MM_PROFILE_NSITES].count.nallocs > 0)
+    {
+      heapprof_count(attr, &rd, "(other)",
+                     &prof->site[CONFIG_MM_PROFILE_NSITES].count);
+    }
+
+  /* Update the file offset */
+
+  filep->f_pos += rd.totalsize;
+  return rd.totalsize;
+}
+
+/****************************************************************************
+ * Name: heapprof_dup
+ *
+ * Description:
+ *   Duplicate open file data in the new file structure.
+ *
+ ****************************************************************************/
+
+static int heapprof_dup(FAR const struct file *oldp, FAR struct file *newp)
+{
+  FAR struct heapprof_file_s *oldattr;
+  FAR struct heapprof_file_s *newattr;
+
+  fvdbg("Dup %p->%p\n", oldp, newp);
+
+  /* Recover our private data from the old struct file instance */
+
+  oldattr = (FAR struct heapprof_file_s *)oldp->f_priv;
+  DEBUGASSERT(oldattr);
+
+  /* Allocate a new container to hold the task and attribute selection */
+
+  newattr = (FAR struct heapprof_file_s *)
+    kmm_malloc(sizeof(struct heapprof_file_s));
+  if (!newattr)
+    {
+      fdbg("ERROR: Failed to allocate file attributes\n");
+      return -ENOMEM;
+    }
+
+  /* The copy the file attributes from the old attributes to the new */
+
+  memcpy(newattr, oldattr, sizeof(struct heapprof_file_s));
+
+  /* Save the new attributes in the new file structure */
+
+  newp->f_priv = (FAR void *)newattr;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: heapprof_stat
+ *
+ * Description: Return information about a file or directory
+ *
+ ****************************************************************************/
+
+static int heapprof_stat(const char *relpath, struct stat *buf)
+{
+  /* "heapprof" is the only acceptable value for the relpath */
+
+  if (strcmp(relpath, "heapprof") != 0)
+    {
+      fdbg("ERROR: relpath is '%s'\n", relpath);
+      return -ENOENT;
+    }
+
+  /* "heapprof" is the name for a read-only file */
+
+  buf->st_mode    = S_IFREG|S_IROTH|S_IRGRP|S_IRUSR;
+  buf->st_size    = 0;
+  buf->st_blksize = 0;
+  buf->st_blocks  = 0;
+  return OK;
+}
+
+#endif /* CONFIG_MM_PROFILE && !CONFIG_FS_PROCFS_EXCLUDE_HEAPPROF */
+#endif /* !CONFIG_DISABLE_MOUNTPOINT && CONFIG_FS_PROCFS */
@@ -0,0 +1,303 @@
+/****************************************************************************
+ * fs/procfs/fs_procfstrace.c
+ *
+ * Copyright (c) 2015 Google Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <assert.h>
+#include <errno.h>
+#include <debug.h>
+
+#include <nuttx/kmalloc.h>
+#include <nuttx/sched_trace.h>
+#include <nuttx/fs/fs.h>
+#include <nuttx/fs/procfs.h>
+
+#if !defined(CONFIG_DISABLE_MOUNTPOINT) && defined(CONFIG_FS_PROCFS)
+#if defined(CONFIG_SCHED_TRACE) && !defined(CONFIG_FS_PROCFS_EXCLUDE_TRACE)
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+/* This structure describes one open "file" */
+
+struct trace_file_s
+{
+  struct procfs_file_s base;         /* Base open file structure */
+  struct sched_trace_header_s hdr;   /* Header of the snapshot */
+  struct sched_trace_s rec[CONFIG_SCHED_TRACE_NRECORDS]; /* Snapshot taken
+                                      * at f_pos 0 */
+};
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+/* File system methods */
+
+static int     trace_open(FAR struct file *filep, FAR const char *relpath,
+                 int oflags, mode_t mode);
+static int     trace_close(FAR struct file *filep);
+static ssize_t trace_read(FAR struct file *filep, FAR char *buffer,
+                 size_t buflen);
+
+static int     trace_dup(FAR const struct file *oldp,
+                 FAR struct file *newp);
+
+static int     trace_stat(FAR const char *relpath, FAR struct stat *buf);
+
+/****************************************************************************
+ * Public Variables
+ ****************************************************************************/
+
+/* See fs_mount.c -- this structure is explicitly externed there.
+ * We use the old-fashioned kind of initializers so that this will compile
+ * with any compiler.
+ */
+
+const struct procfs_operations trace_operations =
+{
+  trace_open,        /* open */
+  trace_close,       /* close */
+  trace_read,        /* read */
+  NULL,              /* write */
+
+  trace_dup,         /* dup */
+
+  NULL,              /* opendir */
+  NULL,              /* closedir */
+  NULL,              /* readdir */
+  NULL,              /* rewinddir */
+
+  trace_stat         /* stat */
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: trace_open
+ ****************************************************************************/
+
+static int trace_open(FAR struct file *filep, FAR const char *relpath,
+                      int oflags, mode_t mode)
+{
+  FAR struct trace_file_s *attr;
+
+  fvdbg("Open '%s'\n", relpath);
+
+  /* PROCFS is read-only.  Any attempt to open with any kind of write
+   * access is not permitted.
+   */
+
+  if ((oflags & O_WRONLY) != 0 || (oflags & O_RDONLY) == 0)
+    {
+      fdbg("ERROR: Only O_RDONLY supported\n");
+      return -EACCES;
+    }
+
+  /* "trace" is the only acceptable value for the relpath */
+
+  if (strcmp(relpath, "trace") != 0)
+    {
+      fdbg("ERROR: relpath is '%s'\n", relpath);
+      return -ENOENT;
+    }
+
+  /* Allocate a container to hold the file attributes */
+
+  attr = (FAR struct trace_file_s *)kmm_zalloc(sizeof(struct trace_file_s));
+  if (!attr)
+    {
+      fdbg("ERROR: Failed to allocate file attributes\n");
+      return -ENOMEM;
+    }
+
+  /* Save the attributes as the open-specific state in filep->f_priv */
+
+  filep->f_priv = (FAR void *)attr;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: trace_close
+ ****************************************************************************/
+
+static int trace_close(FAR struct file *filep)
+{
+  FAR struct trace_file_s *attr;
+
+  /* Recover our private data from the struct file instance */
+
+  attr = (FAR struct trace_file_s *)filep->f_priv;
+  DEBUGASSERT(attr);
+
+  /* Release the file attributes structure */
+
+  kmm_free(attr);
+  filep->f_priv = NULL;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: trace_read
+ *
+ * Description:
+ *   Return the binary trace: a struct sched_trace_header_s followed by the
+ *   records, oldest first.
+ *
+ ****************************************************************************/
+
+static ssize_t trace_read(FAR struct file *filep, FAR char *buffer,
+                          size_t buflen)
+{
+  FAR struct trace_file_s *attr;
+  size_t copysize;
+  size_t totalsize;
+  size_t recsize;
+  off_t offset;
+
+  fvdbg("buffer=%p buflen=%d\n", buffer, (int)buflen);
+
+  /* Recover our private data from the struct file instance */
+
+  attr = (FAR struct trace_file_s *)filep->f_priv;
+  DEBUGASSERT(attr);
+
+  /* If f_pos is zero, then take a snapshot of the trace.  Otherwise, keep
+   * on using the snapshot taken by the first read() so that the output
+   * remains stable throughout the reads.
+   */
+
+  if (filep->f_pos == 0)
+    {
+      (void)sched_trace_dump(&attr->hdr, attr->rec,
+                             CONFIG_SCHED_TRACE_NRECORDS);
+    }
+
+  /* Transfer the header, then the records */
+
+  offset    = filep->f_pos;
+  totalsize = procfs_memcpy((FAR const char *)&attr->hdr,
+                            sizeof(struct sched_trace_header_s),
+                            buffer, buflen, &offset);
+
+  recsize    = attr->hdr.nrecords * sizeof(struct sched_trace_s);
+  copysize   = procfs_memcpy((FAR const char *)attr->rec, recsize,
+                             buffer + totalsize, buflen - totalsize, &offset);
+  totalsize += copysize;
+
+  /* Update the file offset */
+
+  filep->f_pos += totalsize;
+  return totalsize;
+}
+
+/****************************************************************************
+ * Name: trace_dup
+ *
+ * Description:
+ *   Duplicate open file data in the new file structure.
+ *
+ ****************************************************************************/
+
+static int trace_dup(FAR const struct file *oldp, FAR struct file *newp)
+{
+  FAR struct trace_file_s *oldattr;
+  FAR struct trace_file_s *newattr;
+
+  fvdbg("Dup %p->%p\n", oldp, newp);
+
+  /* Recover our private data from the old struct file instance */
+
+  oldattr = (FAR struct trace_file_s *)oldp->f_priv;
+  DEBUGASSERT(oldattr);
+
+  /* Allocate a new container to hold the task and attribute selection */
+
+  newattr = (FAR struct trace_file_s *)
+    kmm_malloc(sizeof(struct trace_file_s));
+  if (!newattr)
+    {
+      fdbg("ERROR: Failed to allocate file attributes\n");
+      return -ENOMEM;
+    }
+
+  /* The copy the file attributes from the old attributes to the new */
+
+  memcpy(newattr, oldattr, sizeof(struct trace_file_s));
+
+  /* Save the new attributes in the new file structure */
+
+  newp->f_priv = (FAR void *)newattr;
+  return OK;
+}
+
+/****************************************************************************
+ * Name: trace_stat
+ *
+ * Description: Return information about a file or directory
+ *
+ ****************************************************************************/
+
+static int trace_stat(const char *relpath, struct stat *buf)
+{
+  /* "trace" is the only acceptable value for the relpath */
+
+  if (strcmp(relpath, "trace") != 0)
+    {
+      fdbg("ERROR: relpath is '%s'\n", relpath);
+      return -ENOENT;
+    }
+
+  /* "trace" is the name for a read-only file */
+
+  buf->st_mode    = S_IFREG|S_IROTH|S_IRGRP|S_IRUSR;
+  buf->st_size    = 0;
+  buf->st_blksize = 0;
+  buf->st_blocks  = 0;
+  return OK;
+}
+
+#endif /* CONFIG_SCHED_TRACE && !CONFIG_FS_PROCFS_EXCLUDE_TRACE */
+#endif /* !CONFIG_DISABLE_MOUNTPOINT && CONFIG_FS_PROCFS */
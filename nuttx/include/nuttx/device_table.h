@@ -68,6 +68,14 @@ struct device_table_iter {
  */
 int device_table_register(struct device_table *table);
 
+/**
+ * @brief Find a device by type and identifier
+ * @param type The type of the device
+ * @param id The identifier of the device within its type
+ * @return The device, or NULL if no registered device matches
+ */
+struct device *device_table_find(const char *type, unsigned int id);
+
 /**
  * @brief Get the next device from a device table iterator
  * @param iter The device table iterator
@@ -46,6 +46,10 @@
 
 #define GB_INVALID_TYPE         0x7f
 
+/* gb_driver priorities, used by the shared worker pool */
+#define GB_DRIVER_PRIORITY_DEFAULT  0
+#define GB_DRIVER_PRIORITY_HIGH     1
+
 enum gb_event {
     GB_EVT_CONNECTED,
     GB_EVT_DISCONNECTED,
@@ -55,6 +59,11 @@ struct gb_operation;
 
 typedef void (*gb_operation_callback)(struct gb_operation *operation);
 typedef uint8_t (*gb_operation_handler_t)(struct gb_operation *operation);
+/*
+ * Fast handlers run in the RX path and send their own response. The message
+ * is only valid during the call: the core releases it once the handler
+ * returns, so it must be copied if needed later.
+ */
 typedef void (*gb_operation_fast_handler_t)(unsigned int cport, void *data);
 
 #if !defined(CONFIG_GREYBUS_DEBUG)
@@ -116,7 +125,7 @@ struct gb_operation {
     unsigned int cport;
     bool has_responded;
     atomic_t ref_count;
-    struct timespec time;
+    uint32_t deadline;
 
     void *request_buffer;
     void *response_buffer;
@@ -127,6 +136,7 @@ struct gb_operation {
 
     void *priv_data;
     struct list_head list;
+    struct list_head inflight_list;
 
     struct gb_operation *response;
 
@@ -138,6 +148,13 @@ struct gb_operation {
 #endif
 };
 
+struct gb_operation_pool_stats {
+    unsigned int size;          /* number of preallocated operations */
+    unsigned int in_use;        /* preallocated operations currently in use */
+    unsigned int high_water;    /* maximum value reached by in_use */
+    unsigned int fallbacks;     /* allocations the pool could not satisfy */
+};
+
 struct gb_driver {
     /*
      * This is the callback in which all the initialization of driver-specific
@@ -157,6 +174,12 @@ struct gb_driver {
 
     struct gb_operation_handler *op_handlers;
 
+    /*
+     * With CONFIG_GREYBUS_WORKER_POOL, cports with pending messages are
+     * served by the shared workers in decreasing priority order. Otherwise
+     * each cport has its own worker thread using stack_size bytes of stack.
+     */
+    uint8_t priority;
     size_t stack_size;
     size_t op_handlers_count;
     const char *name;
@@ -164,6 +187,29 @@ struct gb_driver {
     struct gb_bundle *bundle;
 };
 
+/*
+ * Entry of the protocol registry. Each protocol driver declares itself with
+ * GB_PROTOCOL_DRIVER(), and enable_cports() uses the registry to find the
+ * register function matching the protocol of each cport in the manifest.
+ *
+ * Nothing references gb_protocol_driver_<name>, so the board makefiles pass
+ * -u for each driver listed in drivers/greybus/Protocols.defs to pull it out
+ * of libdrivers.a.
+ */
+struct gb_protocol_driver {
+    uint8_t protocol;
+    const char *name;
+    void (*register_cport)(int cport, int bundle);
+};
+
+#define GB_PROTOCOL_DRIVER(_name, _protocol, _register)                     \
+    const struct gb_protocol_driver gb_protocol_driver_##_name              \
+    __attribute__((section(".gb_protocols"), used, aligned(4))) = {         \
+        .protocol = (_protocol),                                            \
+        .name = #_name,                                                     \
+        .register_cport = (_register),                                      \
+    }
+
 struct gb_operation_hdr {
     __le16 size;
     __le16 id;
@@ -237,12 +283,16 @@ static inline int gb_register_named_driver(unsigned int cport, int bundle,
 
 #define gb_register_driver(cport, bundle, driver) \
     gb_register_named_driver(cport, bundle, driver, __FILE__)
+int gb_set_transport(unsigned int cport,
+                     struct gb_transport_backend *transport);
 int gb_listen(unsigned int cport);
 int gb_stop_listening(unsigned int cport);
 int gb_notify(unsigned cport, enum gb_event event);
 
 void gb_operation_destroy(struct gb_operation *operation);
 void *gb_operation_alloc_response(struct gb_operation *operation, size_t size);
+void *gb_operation_alloc_response_in_place(struct gb_operation *operation,
+                                           size_t size);
 int gb_operation_send_response(struct gb_operation *operation, uint8_t result);
 int gb_operation_send_request_nowait(struct gb_operation *operation,
                                      gb_operation_callback callback,
@@ -251,6 +301,9 @@ int gb_operation_send_request_sync(struct gb_operation *operation);
 int gb_operation_send_request(struct gb_operation *operation,
                               gb_operation_callback callback,
                               bool need_response);
+int gb_operation_send_request_timeout(struct gb_operation *operation,
+                                      gb_operation_callback callback,
+                                      unsigned int timeout_ms);
 struct gb_operation *gb_operation_create(unsigned int cport, uint8_t type,
                                          uint32_t req_size);
 void gb_operation_ref(struct gb_operation *operation);
@@ -259,12 +312,15 @@ size_t gb_operation_get_request_payload_size(struct gb_operation *operation);
 uint8_t gb_operation_get_request_result(struct gb_operation *operation);
 struct gb_bundle *gb_operation_get_bundle(struct gb_operation *operation);
 int greybus_rx_handler(unsigned int, void*, size_t);
+int gb_rx_handler_copy(unsigned int cport, const void *data, size_t size);
 
 int gb_i2c_set_dev(struct i2c_dev_s *dev);
 struct  i2c_dev_s *gb_i2c_get_dev(void);
 
 uint8_t gb_errno_to_op_result(int err);
 
+int gb_operation_get_pool_stats(struct gb_operation_pool_stats *stats);
+
 struct gb_bundle *gb_bundle_get_by_id(unsigned int bundle_id);
 
 #endif /* _GREYBUS_H_ */
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2015 Google Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __GREYBUS_LOCAL_H__
+#define __GREYBUS_LOCAL_H__
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * In-memory transport backend. Instead of going through UniPro, every
+ * message sent by the Greybus core on a local cport is handed to a peer
+ * callback, and the peer feeds messages to the core with gb_local_inject().
+ * This allows to exercise and measure the Greybus stack without a UniPro
+ * link, alongside the cports that are connected to the real link.
+ */
+
+typedef void (*gb_local_peer_rx_t)(unsigned int cport, const void *data,
+                                   size_t size);
+
+struct gb_local_stats {
+    uint32_t alloc_count;   /* buffers allocated by the core */
+    uint32_t tx_count;      /* messages sent by the core */
+    uint32_t rx_count;      /* messages injected into the core */
+};
+
+int gb_local_init(unsigned int cport, gb_local_peer_rx_t peer);
+int gb_local_inject(unsigned int cport, const void *data, size_t size);
+void gb_local_get_stats(struct gb_local_stats *stats);
+
+#endif /* __GREYBUS_LOCAL_H__ */
@@ -76,6 +76,10 @@ struct gb_loopback_statistics {
     unsigned latency_min;
     unsigned latency_max;
     unsigned latency_avg;
+    unsigned latency_p50;
+    unsigned latency_p90;
+    unsigned latency_p99;
+    unsigned latency_p999;
 
     unsigned reqs_per_sec_min;
     unsigned reqs_per_sec_max;
@@ -31,6 +31,7 @@
 #ifndef __GREYBUS_TAPE_H__
 #define __GREYBUS_TAPE_H__
 
+#include <stdint.h>
 #include <sys/types.h>
 
 enum {
@@ -38,6 +39,17 @@ enum {
     GB_TAPE_WRONLY,
 };
 
+/* direction of a recorded message */
+enum {
+    GB_TAPE_RX,
+    GB_TAPE_TX,
+};
+
+enum gb_tape_replay_mode {
+    GB_TAPE_REPLAY_FAST,        /* as fast as possible */
+    GB_TAPE_REPLAY_PACED,       /* with the timing of the recording */
+};
+
 struct gb_tape_mechanism {
     int (*open)(const char *pathname, int mode);
     void (*close)(int fd);
@@ -51,7 +63,8 @@ int gb_tape_arm_semihosting_register(void);
 
 int gb_tape_communication(const char *pathname);
 int gb_tape_stop(void);
-int gb_tape_replay(const char *pathname);
+uint32_t gb_tape_get_dropped_count(void);
+int gb_tape_replay(const char *pathname, enum gb_tape_replay_mode mode);
 
 #endif /* __GREYBUS_TAPE_H__ */
 
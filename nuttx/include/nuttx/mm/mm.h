@@ -183,6 +183,35 @@
 #define MM_IS_ALLOCATED(n) \
   ((int)((struct mm_allocnode_s*)(n)->preceding) < 0))
 
+/* Size classes.  Small chunks of exactly 16, 32, 64, 128 or 256 bytes
+ * (header included) are kept on per-class free lists when they are freed
+ * and handed out again without going through the heap.
+ */
+
+#ifdef CONFIG_MM_SIZE_CLASSES
+#  ifndef CONFIG_MM_SIZE_CLASS_DEPTH
+#    define CONFIG_MM_SIZE_CLASS_DEPTH 16
+#  endif
+#  define MM_NCLASSES         5
+#  define MM_MAX_CLASS_CHUNK  (MM_MIN_CHUNK << (MM_NCLASSES - 1))
+#endif
+
+/* Allocation profiling.  Each allocated chunk carries a small tag in its
+ * last bytes identifying the task and the call site that allocated it.
+ */
+
+#ifdef CONFIG_MM_PROFILE
+#  ifndef CONFIG_MM_PROFILE_NTASKS
+#    define CONFIG_MM_PROFILE_NTASKS 16
+#  endif
+#  ifndef CONFIG_MM_PROFILE_NSITES
+#    define CONFIG_MM_PROFILE_NSITES 32
+#  endif
+#  define SIZEOF_MM_ALLOCTAG  2
+#else
+#  define SIZEOF_MM_ALLOCTAG  0
+#endif
+
 /****************************************************************************
  * Public Types
  ****************************************************************************/
@@ -244,6 +273,67 @@ struct mm_freenode_s
 #define CHECK_FREENODE_SIZE \
   DEBUGASSERT(sizeof(struct mm_freenode_s) == SIZEOF_MM_FREENODE)
 
+#ifdef CONFIG_MM_SIZE_CLASSES
+/* This describes the cache of one size class.  Cached chunks remain
+ * marked as allocated; the link to the next one is kept in the payload.
+ */
+
+struct mm_sizeclass_s
+{
+  FAR void *freelist;      /* Cached chunks (payload addresses) */
+  uint16_t count;          /* Number of cached chunks */
+  uint32_t hits;           /* Allocations served from the cache */
+  uint32_t misses;         /* Allocations that fell back to the heap */
+};
+#endif
+
+#ifdef CONFIG_MM_PROFILE
+/* This is the tag found at the end of each allocated chunk.  The last
+ * entry of each table collects whatever did not fit in the table.
+ */
+
+struct mm_alloctag_s
+{
+  uint8_t task;            /* Index in mm_profile_s task[] */
+  uint8_t site;            /* Index in mm_profile_s site[] */
+};
+
+/* Allocation counters, per task and per call site */
+
+struct mm_profcount_s
+{
+  size_t   live;           /* Bytes currently allocated (headers included) */
+  size_t   peak;           /* Highest value of 'live' */
+  uint32_t nallocs;        /* Number of allocations */
+  uint32_t nfrees;         /* Number of frees */
+};
+
+struct mm_proftask_s
+{
+  pid_t pid;               /* -1 once the task has exited */
+#if CONFIG_TASK_NAME_SIZE > 0
+  char name[CONFIG_TASK_NAME_SIZE + 1];
+#endif
+  struct mm_profcount_s count;
+};
+
+struct mm_profsite_s
+{
+  FAR void *caller;        /* Return address of the call, NULL if unused */
+  struct mm_profcount_s count;
+};
+
+struct mm_profile_s
+{
+  uint8_t ntasks;          /* Number of task[] entries in use */
+  uint8_t nsites;          /* Number of site[] entries in use */
+  size_t  live;            /* Bytes currently allocated, all tasks */
+  size_t  peak;            /* Highest value of 'live' */
+  struct mm_proftask_s task[CONFIG_MM_PROFILE_NTASKS + 1];
+  struct mm_profsite_s site[CONFIG_MM_PROFILE_NSITES + 1];
+};
+#endif
+
 /* This describes one heap (possibly with multiple regions) */
 
 struct mm_heap_s
@@ -277,6 +367,18 @@ struct mm_heap_s
    */
 
   struct mm_freenode_s mm_nodelist[MM_NNODES];
+
+#ifdef CONFIG_MM_SIZE_CLASSES
+  /* Caches of recently freed small chunks, one per size class */
+
+  struct mm_sizeclass_s mm_sizeclass[MM_NCLASSES];
+#endif
+
+#ifdef CONFIG_MM_PROFILE
+  /* Allocation profile of this heap */
+
+  struct mm_profile_s mm_profile;
+#endif
 };
 
 /****************************************************************************
@@ -512,6 +614,41 @@ void mm_addfreechunk(FAR struct mm_heap_s *heap,
 
 int mm_size2ndx(size_t size);
 
+/* Functions contained in mm_free.c *****************************************/
+
+#ifdef CONFIG_MM_SIZE_CLASSES
+void mm_heapfree(FAR struct mm_heap_s *heap, FAR void *mem);
+#endif
+
+/* Functions contained in mm_sizeclass.c ************************************/
+
+#ifdef CONFIG_MM_SIZE_CLASSES
+size_t mm_sizeclass_size(size_t size);
+FAR void *mm_sizeclass_alloc(FAR struct mm_heap_s *heap, size_t size);
+bool mm_sizeclass_free(FAR struct mm_heap_s *heap, FAR void *mem);
+int mm_sizeclass_flush(FAR struct mm_heap_s *heap);
+void mm_sizeclass_info(FAR struct mm_heap_s *heap, FAR size_t *cached,
+                       FAR size_t *hits);
+#endif
+
+/* Functions contained in mm_profile.c **************************************/
+
+#ifdef CONFIG_MM_PROFILE
+void mm_profile_initialize(FAR struct mm_heap_s *heap);
+void mm_profile_alloc(FAR struct mm_heap_s *heap, FAR void *mem,
+                      FAR void *caller);
+void mm_profile_free(FAR struct mm_heap_s *heap, FAR void *mem);
+struct mm_alloctag_s mm_profile_detach(FAR struct mm_heap_s *heap,
+                                       FAR void *mem);
+void mm_profile_attach(FAR struct mm_heap_s *heap, FAR void *mem,
+                       struct mm_alloctag_s tag);
+void mm_profile_setcaller(FAR struct mm_heap_s *heap, FAR void *mem,
+                          FAR void *caller);
+void mm_profile_exit(FAR struct mm_heap_s *heap, pid_t pid);
+void mm_profile_snapshot(FAR struct mm_heap_s *heap,
+                         FAR struct mm_profile_s *profile);
+#endif
+
 #undef EXTERN
 #ifdef __cplusplus
 }
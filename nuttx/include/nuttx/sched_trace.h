@@ -0,0 +1,205 @@
+/****************************************************************************
+ * include/nuttx/sched_trace.h
+ *
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#ifndef __INCLUDE_NUTTX_SCHED_TRACE_H
+#define __INCLUDE_NUTTX_SCHED_TRACE_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Configuration ************************************************************/
+
+#ifndef CONFIG_SCHED_TRACE_NRECORDS
+#  define CONFIG_SCHED_TRACE_NRECORDS 256
+#endif
+
+#if CONFIG_SCHED_TRACE_NRECORDS > 32768 || \
+    (CONFIG_SCHED_TRACE_NRECORDS & (CONFIG_SCHED_TRACE_NRECORDS - 1)) != 0
+#  error CONFIG_SCHED_TRACE_NRECORDS must be a power of two up to 32768
+#endif
+
+/* Identification of a trace dump (struct sched_trace_header_s) */
+
+#define SCHED_TRACE_MAGIC    0x43525453  /* "STRC" in little endian */
+#define SCHED_TRACE_VERSION  1
+
+/* Event types.  The meaning of the arguments of each record is given next
+ * to its type; unused arguments are zero.
+ */
+
+#define SCHED_TRACE_SWITCH    1   /* A new task is at the head of the
+                                   * ready-to-run list.  arg8: its priority,
+                                   * arg16: PID of the old task, data: PID
+                                   * of the new task */
+#define SCHED_TRACE_IRQ_ENTER 2   /* arg16: IRQ number */
+#define SCHED_TRACE_IRQ_LEAVE 3   /* arg16: IRQ number */
+#define SCHED_TRACE_SEM_WAIT  4   /* A task blocks on a semaphore.  arg16:
+                                   * PID of the task, data: semaphore */
+#define SCHED_TRACE_SEM_POST  5   /* A post wakes up a task.  arg16: PID of
+                                   * the task, data: semaphore */
+#define SCHED_TRACE_WDOG      6   /* A watchdog fires.  arg8: argc, data:
+                                   * address of the handler */
+#define SCHED_TRACE_GB_RX     7   /* A Greybus message is received.  arg8:
+                                   * operation type, arg16: CPort, data:
+                                   * operation id | result << 16 */
+#define SCHED_TRACE_GB_TX     8   /* A Greybus message is sent.  Same
+                                   * arguments as SCHED_TRACE_GB_RX */
+#define SCHED_TRACE_USER      128 /* First type free for ad-hoc events */
+
+/* Instrumentation hooks.  They compile to nothing when tracing is not
+ * enabled.
+ */
+
+#ifdef CONFIG_SCHED_TRACE
+#  define sched_trace_irqenter(irq) \
+     sched_trace(SCHED_TRACE_IRQ_ENTER, 0, (irq), 0)
+#  define sched_trace_irqleave(irq) \
+     sched_trace(SCHED_TRACE_IRQ_LEAVE, 0, (irq), 0)
+#  define sched_trace_semwait(tcb, sem) \
+     sched_trace(SCHED_TRACE_SEM_WAIT, 0, (tcb)->pid, \
+                 (uint32_t)(uintptr_t)(sem))
+#  define sched_trace_sempost(tcb, sem) \
+     sched_trace(SCHED_TRACE_SEM_POST, 0, (tcb)->pid, \
+                 (uint32_t)(uintptr_t)(sem))
+#  define sched_trace_wdog(wdog) \
+     sched_trace(SCHED_TRACE_WDOG, (wdog)->argc, 0, \
+                 (uint32_t)(uintptr_t)(wdog)->func)
+#else
+#  define sched_trace(t, a8, a16, d)
+#  define sched_trace_switch(from, to)
+#  define sched_trace_irqenter(irq)
+#  define sched_trace_irqleave(irq)
+#  define sched_trace_semwait(tcb, sem)
+#  define sched_trace_sempost(tcb, sem)
+#  define sched_trace_wdog(wdog)
+#endif
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+
+/* One trace record */
+
+struct sched_trace_s
+{
+  uint32_t time;               /* hrt_getusec() when the event occurred */
+  uint8_t  type;               /* Event type, SCHED_TRACE_* */
+  uint8_t  arg8;               /* Event arguments, see the event types */
+  uint16_t arg16;
+  uint32_t data;
+};
+
+/* A trace dump is this header followed by nrecords records, oldest first */
+
+struct sched_trace_header_s
+{
+  uint32_t magic;              /* SCHED_TRACE_MAGIC */
+  uint8_t  version;            /* SCHED_TRACE_VERSION */
+  uint8_t  recsize;            /* sizeof(struct sched_trace_s) */
+  uint16_t nrecords;           /* Number of records in the dump */
+  uint32_t lost;               /* Older records missing from the dump */
+  uint32_t time;               /* hrt_getusec() when the dump was taken */
+};
+
+/****************************************************************************
+ * Public Function Prototypes
+ ****************************************************************************/
+
+#ifdef __cplusplus
+#define EXTERN extern "C"
+extern "C"
+{
+#else
+#define EXTERN extern
+#endif
+
+#ifdef CONFIG_SCHED_TRACE
+struct tcb_s;
+
+/****************************************************************************
+ * Name: sched_trace
+ *
+ * Description:
+ *   Add one record to the trace ring, overwriting the oldest record if the
+ *   ring is full.  May be called from interrupt handlers.
+ *
+ ****************************************************************************/
+
+void sched_trace(uint8_t type, uint8_t arg8, uint16_t arg16, uint32_t data);
+
+/****************************************************************************
+ * Name: sched_trace_switch
+ *
+ * Description:
+ *   Record that the task at the head of the ready-to-run list changes from
+ *   'from' to 'to'.
+ *
+ ****************************************************************************/
+
+void sched_trace_switch(FAR struct tcb_s *from, FAR struct tcb_s *to);
+
+/****************************************************************************
+ * Name: sched_trace_dump
+ *
+ * Description:
+ *   Take a consistent copy of the trace ring.
+ *
+ * Input Parameters:
+ *   hdr      - Receives the header of the dump
+ *   buffer   - Receives the records, oldest first
+ *   nrecords - Room in buffer, in records.  Only the most recent records
+ *              are copied if it is smaller than the ring.
+ *
+ * Returned Value:
+ *   The number of records copied, also found in hdr->nrecords.
+ *
+ ****************************************************************************/
+
+size_t sched_trace_dump(FAR struct sched_trace_header_s *hdr,
+                        FAR struct sched_trace_s *buffer, size_t nrecords);
+#endif
+
+#undef EXTERN
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __INCLUDE_NUTTX_SCHED_TRACE_H */
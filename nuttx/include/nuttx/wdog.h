@@ -139,6 +139,11 @@ struct wdog_s
   uint8_t            flags;      /* See WDOGF_* definitions above */
   uint8_t            argc;       /* The number of parameters to pass */
   uint32_t           parm[CONFIG_MAX_WDOGPARMS];
+#ifdef CONFIG_WDOG_TIMERWHEEL
+  FAR struct wdog_s *prev;       /* Support for timer wheel bucket lists */
+  uint32_t           expiry;     /* Absolute expiration time in ticks */
+  uint8_t            bucket;     /* Timer wheel bucket holding the watchdog */
+#endif
 };
 
 /* Watchdog 'handle' */
@@ -67,8 +67,9 @@
  *   in order to build the high priority work queue.
  * CONFIG_SCHED_WORKPRIORITY - The execution priority of the worker
  *   thread.  Default: 192
- * CONFIG_SCHED_WORKPERIOD - How often the worker thread checks for
- *   work in units of microseconds.  Default: 50*1000 (50 MS).
+ * CONFIG_SCHED_WORKPERIOD - Formerly how often the worker thread checked
+ *   for work.  Worker threads now sleep until the next queued work is due
+ *   and this setting is ignored.
  * CONFIG_SCHED_WORKSTACKSIZE - The stack size allocated for the worker
  *   thread.  Default: CONFIG_IDLETHREAD_STACKSIZE.
  * CONFIG_SIG_SIGWORK - The signal number that will be used to wake-up
@@ -81,8 +82,7 @@
  *   (such as file system clean-up operations)
  * CONFIG_SCHED_LPWORKPRIORITY - The execution priority of the lower priority
  *   worker thread.  Default: 50
- * CONFIG_SCHED_LPWORKPERIOD - How often the lower priority worker thread
- *  checks for work in units of microseconds.  Default: 50*1000 (50 MS).
+ * CONFIG_SCHED_LPWORKPERIOD - Ignored, see CONFIG_SCHED_WORKPERIOD.
  * CONFIG_SCHED_LPWORKSTACKSIZE - The stack size allocated for the lower
  *   priority worker thread.  Default: CONFIG_IDLETHREAD_STACKSIZE.
  */
@@ -212,6 +212,28 @@
 
 #endif /* CONFIG_SCHED_USRWORK */
 
+/* The largest number of threads servicing one work queue.  The user space
+ * work queue always has a single thread.
+ */
+
+#ifndef CONFIG_SCHED_HPNTHREADS
+#  define CONFIG_SCHED_HPNTHREADS 1
+#endif
+
+#ifndef CONFIG_SCHED_LPNTHREADS
+#  define CONFIG_SCHED_LPNTHREADS 1
+#endif
+
+#if CONFIG_SCHED_HPNTHREADS > CONFIG_SCHED_LPNTHREADS
+#  define WORK_MAXTHREADS CONFIG_SCHED_HPNTHREADS
+#else
+#  define WORK_MAXTHREADS CONFIG_SCHED_LPNTHREADS
+#endif
+
+#if WORK_MAXTHREADS > 8
+#  error "No more than 8 worker threads per work queue are supported"
+#endif
+
 /* How many worker threads are there?  In the user-space phase of a kernel
  * build, there will be no more than one.
  *
@@ -278,8 +300,17 @@
 
 struct wqueue_s
 {
-  pid_t             pid; /* The task ID of the worker thread */
-  struct dq_queue_s q;   /* The queue of pending work */
+  pid_t             pid; /* The task ID of the (first) worker thread */
+  struct dq_queue_s q;   /* The queue of pending work, sorted by due time */
+#if WORK_MAXTHREADS > 1
+  uint8_t           nthreads;                /* Number of worker threads */
+  volatile uint8_t  idle;                    /* Set of waiting threads */
+  pid_t             worker[WORK_MAXTHREADS]; /* Task IDs of all threads */
+  FAR struct work_s *running[WORK_MAXTHREADS]; /* Work run by each thread */
+#endif
+#ifdef CONFIG_SCHED_WORKQUEUE_LOCKFREE
+  FAR struct work_s *inbox; /* Work queued but not yet sorted into q */
+#endif
 };
 
 /* Defines the work callback */
@@ -94,6 +94,11 @@ struct mallinfo
                  * chunks handed out by malloc. */
   int fordblks; /* This is the total size of memory occupied
                  * by free (not in use) chunks.*/
+#ifdef CONFIG_MM_SIZE_CLASSES
+  int cachedblks; /* Size of the free chunks held in the size class
+                   * caches (included in fordblks) */
+  int cachehits;  /* Number of allocations served from the caches */
+#endif
 };
 
 /****************************************************************************
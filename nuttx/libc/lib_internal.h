@@ -244,6 +244,16 @@ double lib_expi(size_t n);
 float lib_sqrtapprox(float x);
 #endif
 
+/* Defined in work_queue.c and work_signal.c */
+
+#ifdef CONFIG_SCHED_WORKQUEUE
+struct wqueue_s;
+struct work_s;
+
+void work_insert(FAR struct wqueue_s *wqueue, FAR struct work_s *work);
+int work_wakeup(FAR struct wqueue_s *wqueue);
+#endif
+
 #undef EXTERN
 #if defined(__cplusplus)
 }
@@ -105,6 +105,36 @@ int work_cancel(int qid, FAR struct work_s *work)
   flags = irqsave();
   if (work->worker != NULL)
     {
+#ifdef CONFIG_SCHED_WORKQUEUE_LOCKFREE
+      FAR struct work_s *prev = NULL;
+      FAR struct work_s *curr;
+
+      /* The work may still be in the inbox.  With interrupts disabled,
+       * nobody else can be emptying it, and work_queue() retries its
+       * compare-and-swap if the head is removed under it.
+       */
+
+      for (curr = wqueue->inbox;
+           curr && curr != work;
+           prev = curr, curr = (FAR struct work_s *)curr->dq.flink);
+
+      if (curr)
+        {
+          if (prev)
+            {
+              prev->dq.flink = work->dq.flink;
+            }
+          else
+            {
+              wqueue->inbox = (FAR struct work_s *)work->dq.flink;
+            }
+
+          work->worker = NULL;
+          irqrestore(flags);
+          return OK;
+        }
+#endif
+
       /* A little test of the integrity of the work queue */
 
       DEBUGASSERT(work->dq.flink || (FAR dq_entry_t *)work == wqueue->q.tail);
@@ -49,6 +49,8 @@
 #include <nuttx/clock.h>
 #include <nuttx/wqueue.h>
 
+#include "lib_internal.h"
+
 #ifdef CONFIG_SCHED_WORKQUEUE
 
 /****************************************************************************
@@ -75,6 +77,73 @@
  * Public Functions
  ****************************************************************************/
 
+/****************************************************************************
+ * Name: work_insert
+ *
+ * Description:
+ *   Insert work in the work queue, which is kept sorted by the time at which
+ *   each entry is due.  Work that is due at the same time is performed in
+ *   the order that it was queued.
+ *
+ * Input parameters:
+ *   wqueue - The work queue
+ *   work   - The time-tagged work structure to insert
+ *
+ * Returned Value:
+ *   None
+ *
+ * Assumptions:
+ *   Interrupts are disabled.  This is used internally by the work logic.
+ *
+ ****************************************************************************/
+
+void work_insert(FAR struct wqueue_s *wqueue, FAR struct work_s *work)
+{
+  FAR struct work_s *curr;
+  uint32_t due = work->qtime + work->delay;
+
+  if (work->delay == 0)
+    {
+      /* Immediate work goes after the little work that is already due, so
+       * search from the head.
+       */
+
+      for (curr = (FAR struct work_s *)wqueue->q.head;
+           curr && (int32_t)(curr->qtime + curr->delay - due) <= 0;
+           curr = (FAR struct work_s *)curr->dq.flink);
+
+      if (curr)
+        {
+          dq_addbefore((FAR dq_entry_t *)curr, (FAR dq_entry_t *)work,
+                       &wqueue->q);
+        }
+      else
+        {
+          dq_addlast((FAR dq_entry_t *)work, &wqueue->q);
+        }
+    }
+  else
+    {
+      /* Delayed work usually expires after most of what is already queued,
+       * so search from the tail.
+       */
+
+      for (curr = (FAR struct work_s *)wqueue->q.tail;
+           curr && (int32_t)(curr->qtime + curr->delay - due) > 0;
+           curr = (FAR struct work_s *)curr->dq.blink);
+
+      if (curr)
+        {
+          dq_addafter((FAR dq_entry_t *)curr, (FAR dq_entry_t *)work,
+                      &wqueue->q);
+        }
+      else
+        {
+          dq_addfirst((FAR dq_entry_t *)work, &wqueue->q);
+        }
+    }
+}
+
 /****************************************************************************
  * Name: work_queue
  *
@@ -108,7 +177,11 @@ int work_queue(int qid, FAR struct work_s *work, worker_t worker,
                FAR void *arg, uint32_t delay)
 {
   FAR struct wqueue_s *wqueue = &g_work[qid];
+#ifdef CONFIG_SCHED_WORKQUEUE_LOCKFREE
+  FAR struct work_s *head;
+#else
   irqstate_t flags;
+#endif
 
   DEBUGASSERT(work != NULL && (unsigned)qid < NWORKERS);
 
@@ -118,6 +191,34 @@ int work_queue(int qid, FAR struct work_s *work, worker_t worker,
   work->arg    = arg;              /* Callback argument */
   work->delay  = delay;            /* Delay until work performed */
 
+#ifdef CONFIG_SCHED_WORKQUEUE_LOCKFREE
+  /* Time-tag the entry and push it on the inbox of the work queue.  The
+   * compare-and-swap makes this safe against other tasks and interrupt
+   * handlers queuing work at the same time, without disabling interrupts.
+   * The worker threads sort the inbox into the work queue.
+   */
+
+  work->qtime = clock_systimer(); /* Time work queued */
+
+  head = __atomic_load_n(&wqueue->inbox, __ATOMIC_RELAXED);
+  do
+    {
+      work->dq.flink = (FAR dq_entry_t *)head;
+    }
+  while (!__atomic_compare_exchange_n(&wqueue->inbox, &head, work, true,
+                                      __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+  /* Only the first work in the inbox needs to wake up a worker thread:
+   * the inbox is emptied all at once.
+   */
+
+  if (head == NULL)
+    {
+      (void)work_wakeup(wqueue);
+    }
+
+  return OK;
+#else
   /* Now, time-tag that entry and put it in the work queue.  This must be
    * done with interrupts disabled.  This permits this function to be called
    * from with task logic or interrupt handlers.
@@ -126,11 +227,20 @@ int work_queue(int qid, FAR struct work_s *work, worker_t worker,
   flags        = irqsave();
   work->qtime  = clock_systimer(); /* Time work queued */
 
-  dq_addlast((FAR dq_entry_t *)work, &wqueue->q);
-  kill(wqueue->pid, SIGWORK);      /* Wake up the worker thread */
+  work_insert(wqueue, work);
+
+  /* The worker thread sleeps until the work at the head of the queue is
+   * due.  Wake it up only if the new work is now the first due.
+   */
+
+  if (wqueue->q.head == (FAR dq_entry_t *)work)
+    {
+      (void)work_wakeup(wqueue);
+    }
 
   irqrestore(flags);
   return OK;
+#endif
 }
 
 #endif /* CONFIG_SCHED_WORKQUEUE */
@@ -44,6 +44,8 @@
 
 #include <nuttx/wqueue.h>
 
+#include "lib_internal.h"
+
 #ifdef CONFIG_SCHED_WORKQUEUE
 
 /****************************************************************************
@@ -69,6 +71,42 @@
 /****************************************************************************
  * Public Functions
  ****************************************************************************/
+/****************************************************************************
+ * Name: work_wakeup
+ *
+ * Description:
+ *   Wake up a worker thread of a work queue.  When several threads service
+ *   the queue, one that is waiting is picked;  if none is waiting, they are
+ *   all busy and will look at the queue again when they are done.
+ *
+ * Input parameters:
+ *   wqueue - The work queue
+ *
+ * Returned Value:
+ *   Zero on success, a negated errno on failure
+ *
+ ****************************************************************************/
+
+int work_wakeup(FAR struct wqueue_s *wqueue)
+{
+#if WORK_MAXTHREADS > 1
+  uint8_t idle;
+
+  if (wqueue->nthreads > 1)
+    {
+      idle = wqueue->idle;
+      if (idle == 0)
+        {
+          return OK;
+        }
+
+      return kill(wqueue->worker[__builtin_ctz(idle)], SIGWORK);
+    }
+#endif
+
+  return kill(wqueue->pid, SIGWORK);
+}
+
 /****************************************************************************
  * Name: work_signal
  *
@@ -88,7 +126,7 @@
 int work_signal(int qid)
 {
   DEBUGASSERT((unsigned)qid < NWORKERS);
-  return kill(g_work[qid].pid, SIGWORK);
+  return work_wakeup(&g_work[qid]);
 }
 
 #endif /* CONFIG_SCHED_WORKQUEUE */
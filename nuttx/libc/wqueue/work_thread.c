@@ -40,7 +40,9 @@
 #include <nuttx/config.h>
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <unistd.h>
+#include <signal.h>
 #include <queue.h>
 #include <assert.h>
 #include <errno.h>
@@ -51,6 +53,8 @@
 #include <nuttx/clock.h>
 #include <nuttx/kmalloc.h>
 
+#include "lib_internal.h"
+
 #ifdef CONFIG_SCHED_WORKQUEUE
 
 /****************************************************************************
@@ -97,121 +101,253 @@ struct wqueue_s g_work[NWORKERS];
  * Private Functions
  ****************************************************************************/
 
+/****************************************************************************
+ * Name: work_index
+ *
+ * Description:
+ *   Return the index of the calling thread among the worker threads of a
+ *   work queue.
+ *
+ ****************************************************************************/
+
+static int work_index(FAR struct wqueue_s *wqueue)
+{
+#if WORK_MAXTHREADS > 1
+  pid_t pid = getpid();
+  int i;
+
+  for (i = 0; i < wqueue->nthreads; i++)
+    {
+      if (wqueue->worker[i] == pid)
+        {
+          return i;
+        }
+    }
+#endif
+
+  return 0;
+}
+
+/****************************************************************************
+ * Name: work_isrunning
+ *
+ * Description:
+ *   Return true if the work is being run by another worker thread of the
+ *   work queue.
+ *
+ * Assumptions:
+ *   Interrupts are disabled.
+ *
+ ****************************************************************************/
+
+static bool work_isrunning(FAR struct wqueue_s *wqueue, int wndx,
+                           FAR struct work_s *work)
+{
+#if WORK_MAXTHREADS > 1
+  int i;
+
+  for (i = 0; i < wqueue->nthreads; i++)
+    {
+      if (i != wndx && wqueue->running[i] == work)
+        {
+          return true;
+        }
+    }
+#endif
+
+  return false;
+}
+
+/****************************************************************************
+ * Name: work_drain
+ *
+ * Description:
+ *   Move the work pushed on the inbox by work_queue() into the work queue,
+ *   oldest first.
+ *
+ * Assumptions:
+ *   Interrupts are disabled.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_SCHED_WORKQUEUE_LOCKFREE
+static void work_drain(FAR struct wqueue_s *wqueue)
+{
+  FAR struct work_s *work;
+  FAR struct work_s *next;
+  FAR struct work_s *fifo = NULL;
+
+  work = __atomic_exchange_n(&wqueue->inbox, NULL, __ATOMIC_ACQUIRE);
+
+  /* The inbox holds the most recent work first.  Reverse it. */
+
+  while (work)
+    {
+      next           = (FAR struct work_s *)work->dq.flink;
+      work->dq.flink = (FAR dq_entry_t *)fifo;
+      fifo           = work;
+      work           = next;
+    }
+
+  for (work = fifo; work; work = next)
+    {
+      next = (FAR struct work_s *)work->dq.flink;
+      work_insert(wqueue, work);
+    }
+}
+#endif
+
 /****************************************************************************
  * Name: work_process
  *
  * Description:
- *   This is the logic that performs actions placed on any work list.
+ *   This is the logic that performs actions placed on any work list.  The
+ *   work list is sorted by due time, so only the work at its head needs to
+ *   be examined.  When no work is due, the worker thread sleeps until the
+ *   next work is due, or indefinitely if there is none;  work_queue() and
+ *   work_signal() wake it up early.
  *
  * Input parameters:
  *   wqueue - Describes the work queue to be processed
+ *   wndx   - Index of the calling thread among the queue's worker threads
  *
  * Returned Value:
  *   None
  *
  ****************************************************************************/
 
-static void work_process(FAR struct wqueue_s *wqueue)
+static void work_process(FAR struct wqueue_s *wqueue, int wndx)
 {
   volatile FAR struct work_s *work;
   worker_t  worker;
   irqstate_t flags;
   FAR void *arg;
   uint32_t elapsed;
-  uint32_t remaining;
-  uint32_t next;
+  uint32_t next = 0;
 
   /* Then process queued work.  We need to keep interrupts disabled while
    * we process items in the work list.
    */
 
-  next  = CONFIG_SCHED_WORKPERIOD / USEC_PER_TICK;
   flags = irqsave();
-  work  = (FAR struct work_s *)wqueue->q.head;
-  while (work)
+  for (;;)
     {
-      /* Is this work ready?  It is ready if there is no delay or if
-       * the delay has elapsed. qtime is the time that the work was added
-       * to the work queue.  It will always be greater than or equal to
-       * zero.  Therefore a delay of zero will always execute immediately.
-       */
+#ifdef CONFIG_SCHED_WORKQUEUE_LOCKFREE
+      /* Pick up any work queued since we last looked */
 
-      elapsed = clock_systimer() - work->qtime;
-      if (elapsed >= work->delay)
-        {
-          /* Remove the ready-to-execute work from the list */
-
-          (void)dq_rem((struct dq_entry_s *)work, &wqueue->q);
+      work_drain(wqueue);
+#endif
 
-          /* Extract the work description from the entry (in case the work
-           * instance by the re-used after it has been de-queued).
+      for (work = (FAR struct work_s *)wqueue->q.head;
+           work != NULL;
+           work = (FAR struct work_s *)work->dq.flink)
+        {
+          /* Is this work ready?  It is ready if there is no delay or if
+           * the delay has elapsed. qtime is the time that the work was
+           * added to the work queue.  It will always be greater than or
+           * equal to zero.  Therefore a delay of zero will always execute
+           * immediately.
            */
 
-          worker = work->worker;
+          elapsed = clock_systimer() - work->qtime;
+          if (elapsed < work->delay)
+            {
+              /* Not ready, and neither is any work behind it.  Sleep until
+               * it is due.
+               */
+
+              next = work->delay - elapsed;
+              work = NULL;
+              break;
+            }
 
-          /* Check for a race condition where the work may be nullified
-           * before it is removed from the queue.
+          /* Work that re-queued itself, or that was queued again while it
+           * runs, must not run concurrently with itself:  leave it to the
+           * thread that is running it, which will pick it up when done.
            */
 
-          if (worker != NULL)
+          if (!work_isrunning(wqueue, wndx, (FAR struct work_s *)work))
             {
-              /* Extract the work argument (before re-enabling interrupts) */
-
-              arg = work->arg;
+              break;
+            }
+        }
 
-              /* Mark the work as no longer being queued */
+      if (work == NULL)
+        {
+          break;
+        }
 
-              work->worker = NULL;
+      /* Remove the ready-to-execute work from the list */
 
-              /* Do the work.  Re-enable interrupts while the work is being
-               * performed... we don't have any idea how long that will take!
-               */
+      dq_rem((FAR dq_entry_t *)work, &wqueue->q);
 
-              irqrestore(flags);
-              worker(arg);
+      /* Extract the work description from the entry (in case the work
+       * instance by the re-used after it has been de-queued).
+       */
 
-              /* Now, unfortunately, since we re-enabled interrupts we don't
-               * know the state of the work list and we will have to start
-               * back at the head of the list.
-               */
+      worker = work->worker;
 
-              flags = irqsave();
-              work  = (FAR struct work_s *)wqueue->q.head;
-            }
-          else
-            {
-              /* Cancelled.. Just move to the next work in the list with
-               * interrupts still disabled.
-               */
+      /* Check for a race condition where the work may be nullified
+       * before it is removed from the queue.
+       */
 
-              work = (FAR struct work_s *)work->dq.flink;
-            }
-        }
-      else
+      if (worker != NULL)
         {
-          /* This one is not ready.. will it be ready before the next
-           * scheduled wakeup interval?
-           */
+          /* Extract the work argument (before re-enabling interrupts) */
 
-          remaining = elapsed - work->delay;
-          if (remaining < next)
-            {
-              /* Yes.. Then schedule to wake up when the work is ready */
+          arg = work->arg;
 
-              next = remaining;
-            }
+          /* Mark the work as no longer being queued */
+
+          work->worker = NULL;
 
-          /* Then try the next in the list. */
+          /* Do the work.  Re-enable interrupts while the work is being
+           * performed... we don't have any idea how long that will take!
+           */
 
-          work = (FAR struct work_s *)work->dq.flink;
+#if WORK_MAXTHREADS > 1
+          wqueue->running[wndx] = (FAR struct work_s *)work;
+#endif
+          irqrestore(flags);
+          worker(arg);
+          flags = irqsave();
+#if WORK_MAXTHREADS > 1
+          wqueue->running[wndx] = NULL;
+#endif
         }
     }
 
-  /* Wait awhile to check the work list.  We will wait here until either
-   * the time elapses or until we are awakened by a signal.
+  /* Wait for the next work to become due, or for any work at all.  We will
+   * wait here until either the time elapses or until we are awakened by a
+   * signal.  Interrupts stay disabled until we sleep so that a signal from
+   * work_queue() cannot be missed.
    */
 
-  usleep(next * USEC_PER_TICK);
+#if WORK_MAXTHREADS > 1
+  wqueue->idle |= (1 << wndx);
+#endif
+
+  if (next > 0)
+    {
+      if (next > UINT32_MAX / USEC_PER_TICK)
+        {
+          next = UINT32_MAX / USEC_PER_TICK;
+        }
+
+      usleep(next * USEC_PER_TICK);
+    }
+  else
+    {
+      sigset_t set;
+
+      (void)sigemptyset(&set);
+      (void)sigsuspend(&set);
+    }
+
+#if WORK_MAXTHREADS > 1
+  wqueue->idle &= ~(1 << wndx);
+#endif
+
   irqrestore(flags);
 }
 
@@ -253,6 +389,8 @@ static void work_process(FAR struct wqueue_s *wqueue)
 
 int work_hpthread(int argc, char *argv[])
 {
+  int wndx = work_index(&g_work[HPWORK]);
+
   /* Loop forever */
 
   for (;;)
@@ -272,7 +410,7 @@ int work_hpthread(int argc, char *argv[])
        * we process items in the work list.
        */
 
-      work_process(&g_work[HPWORK]);
+      work_process(&g_work[HPWORK], wndx);
     }
 
   return OK; /* To keep some compilers happy */
@@ -282,6 +420,8 @@ int work_hpthread(int argc, char *argv[])
 
 int work_lpthread(int argc, char *argv[])
 {
+  int wndx = work_index(&g_work[LPWORK]);
+
   /* Loop forever */
 
   for (;;)
@@ -299,7 +439,7 @@ int work_lpthread(int argc, char *argv[])
        * we process items in the work list.
        */
 
-      work_process(&g_work[LPWORK]);
+      work_process(&g_work[LPWORK], wndx);
     }
 
   return OK; /* To keep some compilers happy */
@@ -312,6 +452,8 @@ int work_lpthread(int argc, char *argv[])
 
 int work_usrthread(int argc, char *argv[])
 {
+  int wndx = work_index(&g_work[USRWORK]);
+
   /* Loop forever */
 
   for (;;)
@@ -320,7 +462,7 @@ int work_usrthread(int argc, char *argv[])
        * we process items in the work list.
        */
 
-      work_process(&g_work[USRWORK]);
+      work_process(&g_work[USRWORK], wndx);
     }
 
   return OK; /* To keep some compilers happy */
@@ -32,6 +32,8 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
 
 #include <nuttx/config.h>
 #include <nuttx/list.h>
@@ -44,6 +46,20 @@
 #define MM_BUCKET_MAX           31
 #define MM_CANARY               0xfab0fab0
 
+/*
+ * Smallest block the allocator ever hands out: the control header plus at
+ * least one byte of payload.
+ */
+#define MM_BUCKET_MIN           5
+
+/*
+ * One bit per block and per order, set when the block is free. The sum over
+ * all the orders is bounded by twice the bitmap of the smallest order, plus
+ * one word of rounding per order.
+ */
+#define MM_MAP_WORDS \
+    ((BUFRAM_SIZE >> MM_BUCKET_MIN) / 16 + MM_BUCKET_MAX + 1)
+
 #ifdef CONFIG_MM_BUFRAM_DEBUG
 #define mm_warn(message...) lowsyslog(message)
 #else
@@ -51,6 +67,10 @@
 #endif
 
 static struct list_head mm_bucket[MM_BUCKET_MAX + 1];
+static uint32_t *mm_free_map[MM_BUCKET_MAX + 1];
+static uint32_t mm_free_map_storage[MM_MAP_WORDS];
+static size_t mm_free_count[MM_BUCKET_MAX + 1];
+static uint32_t mm_nonempty; /* bit n set when mm_bucket[n] is not empty */
 
 struct mm_buffer {
     uint32_t canary;
@@ -66,17 +86,10 @@ size_t bufram_size_to_page_count(size_t size)
 
 static int size_to_order(size_t size)
 {
-    int order = -1;
-    size_t bit_set_count = 0;
-
-    for (; size; size >>= 1) {
-        order++;
+    if (size <= 1)
+        return 0;
 
-        if (size & 1)
-            bit_set_count++;
-    }
-
-    return bit_set_count == 1 ? order : order + 1;
+    return 32 - __builtin_clz(size - 1);
 }
 
 static size_t order_to_size(int order)
@@ -84,9 +97,70 @@ static size_t order_to_size(int order)
     return 1 << order;
 }
 
+static inline size_t order_to_block_count(int order)
+{
+    return (BUFRAM_SIZE + order_to_size(order) - 1) >> order;
+}
+
+static inline size_t buffer_index(struct mm_buffer *buffer, int order)
+{
+    return ((uintptr_t) buffer - BUFRAM_BASE) >> order;
+}
+
+static inline bool is_buffer_free(struct mm_buffer *buffer, int order)
+{
+    size_t index;
+
+    if ((uintptr_t) buffer < BUFRAM_BASE)
+        return false;
+
+    index = buffer_index(buffer, order);
+    if (index >= order_to_block_count(order))
+        return false;
+
+    return mm_free_map[order][index / 32] & (1u << (index % 32));
+}
+
+/*
+ * Put a buffer in the bucket of its order and record it as free.
+ * Must be called with interrupts disabled.
+ */
+static void add_free_buffer(struct mm_buffer *buffer)
+{
+    int order = buffer->bucket;
+    size_t index = buffer_index(buffer, order);
+
+    mm_free_map[order][index / 32] |= 1u << (index % 32);
+    mm_free_count[order]++;
+    mm_nonempty |= 1u << order;
+
+    list_add(&mm_bucket[order], &buffer->list);
+}
+
+/*
+ * Take a buffer out of the bucket of its order.
+ * Must be called with interrupts disabled.
+ */
+static void remove_free_buffer(struct mm_buffer *buffer)
+{
+    int order = buffer->bucket;
+    size_t index = buffer_index(buffer, order);
+
+    mm_free_map[order][index / 32] &= ~(1u << (index % 32));
+    if (--mm_free_count[order] == 0)
+        mm_nonempty &= ~(1u << order);
+
+    list_del(&buffer->list);
+}
+
 void bufram_register_region(uintptr_t base, unsigned order)
 {
     struct mm_buffer *buffer;
+    irqstate_t flags;
+
+    DEBUGASSERT(order >= MM_BUCKET_MIN && order <= MM_BUCKET_MAX);
+    DEBUGASSERT(base >= BUFRAM_BASE &&
+                base + order_to_size(order) <= BUFRAM_BASE + BUFRAM_SIZE);
 
     buffer = (struct mm_buffer*) base;
     buffer->bucket = order;
@@ -95,15 +169,32 @@ void bufram_register_region(uintptr_t base, unsigned order)
 #endif
     list_init(&buffer->list);
 
-    list_add(&mm_bucket[buffer->bucket], &buffer->list);
+    flags = irqsave();
+    add_free_buffer(buffer);
+    irqrestore(flags);
 }
 
 void bufram_init(void)
 {
+    uint32_t *map = mm_free_map_storage;
     int i;
 
-    for (i = 0; i < ARRAY_SIZE(mm_bucket); i++)
+    for (i = 0; i < ARRAY_SIZE(mm_bucket); i++) {
         list_init(&mm_bucket[i]);
+        mm_free_count[i] = 0;
+
+        if (i < MM_BUCKET_MIN) {
+            mm_free_map[i] = NULL;
+            continue;
+        }
+
+        mm_free_map[i] = map;
+        map += (order_to_block_count(i) + 31) / 32;
+    }
+
+    DEBUGASSERT(map <= mm_free_map_storage + MM_MAP_WORDS);
+    memset(mm_free_map_storage, 0, sizeof(mm_free_map_storage));
+    mm_nonempty = 0;
 }
 
 static inline void *get_buffer_payload(struct mm_buffer *buffer)
@@ -116,111 +207,71 @@ static inline struct mm_buffer *get_buffer_control_data(void *payload)
     return (struct mm_buffer*) payload - 1;
 }
 
-static struct mm_buffer *find_buffer_in_bucket(int order)
-{
-    if (order > MM_BUCKET_MAX)
-        return NULL;
-
-    if (list_is_empty(&mm_bucket[order]))
-        return NULL;
-
-    return list_entry(mm_bucket[order].next, struct mm_buffer, list);
-}
-
-static int fill_bucket(int order)
+static struct mm_buffer *get_buffer_buddy(struct mm_buffer *buffer)
 {
-    struct mm_buffer *buffer1;
-    struct mm_buffer *buffer2;
-    int retval;
-
-    if (order > MM_BUCKET_MAX)
-        return -ENOMEM;
-
-    buffer1 = find_buffer_in_bucket(order + 1);
-    if (!buffer1) {
-        retval = fill_bucket(order + 1);
-        if (retval)
-            return retval;
-
-        buffer1 = find_buffer_in_bucket(order + 1);
-        DEBUGASSERT(buffer1);
-    }
-
-    list_del(&buffer1->list);
-
-    buffer2 = (struct mm_buffer*) ((char*) buffer1 + order_to_size(order));
-    list_init(&buffer2->list);
-
-    buffer1->bucket = order;
-    buffer2->bucket = order;
-
-#if defined(CONFIG_MM_BUFRAM_CANARY)
-    buffer2->canary = buffer1->canary = MM_CANARY;
-#endif
-
-    list_add(&mm_bucket[order], &buffer1->list);
-    list_add(&mm_bucket[order], &buffer2->list);
+    if (((unsigned long) buffer) & (1 << buffer->bucket))
+        return (struct mm_buffer*)
+            ((char*) buffer - order_to_size(buffer->bucket));
 
-    return 0;
+    return (struct mm_buffer*) ((char*) buffer + order_to_size(buffer->bucket));
 }
 
 static void defragment(struct mm_buffer *buffer)
 {
-    struct list_head *iter;
-    struct mm_buffer *buffer_low;
-    struct mm_buffer *buffer_high;
-    struct mm_buffer *buffer2;
-    struct mm_buffer *buffer3;
+    struct mm_buffer *buddy;
 
-    if (list_is_empty(&mm_bucket[buffer->bucket])) {
-        mm_warn("mm: trying to defragment empty bucket");
-        return;
-    }
+    while (buffer->bucket < MM_BUCKET_MAX) {
+        buddy = get_buffer_buddy(buffer);
+        if (!is_buffer_free(buddy, buffer->bucket))
+            return;
 
-    if (((unsigned long) buffer) & (1 << buffer->bucket)) {
-        buffer_low = buffer2 = (struct mm_buffer*)
-            ((char*) buffer - order_to_size(buffer->bucket));
-        buffer_high = buffer;
-    } else {
-        buffer_low = buffer;
-        buffer_high = buffer2 = (struct mm_buffer*)
-            ((char*) buffer + order_to_size(buffer->bucket));
-    }
+        remove_free_buffer(buffer);
+        remove_free_buffer(buddy);
 
-    list_foreach(&mm_bucket[buffer->bucket], iter) {
-        buffer3 = list_entry(iter, struct mm_buffer, list);
-        if (buffer3 != buffer2)
-            continue;
-
-        list_del(&buffer_low->list);
-        list_del(&buffer_high->list);
-
-        buffer_low->bucket++;
-        list_add(&mm_bucket[buffer_low->bucket], &buffer_low->list);
+        if (buddy < buffer)
+            buffer = buddy;
 
-        defragment(buffer_low);
-
-        return;
+        buffer->bucket++;
+        add_free_buffer(buffer);
     }
 }
 
+/*
+ * Take a free buffer of the requested order, splitting the smallest larger
+ * free buffer if that bucket is empty.
+ */
 static struct mm_buffer *get_buffer(int order)
 {
     struct mm_buffer *buffer;
-    int retval;
+    struct mm_buffer *buffer2;
+    uint32_t candidates;
+    int bucket;
+
+    candidates = mm_nonempty & (~0u << order);
+    if (!candidates)
+        return NULL;
 
-    buffer = find_buffer_in_bucket(order);
-    if (buffer)
-        return buffer;
+    bucket = __builtin_ffs(candidates) - 1;
+    buffer = list_entry(mm_bucket[bucket].next, struct mm_buffer, list);
+    remove_free_buffer(buffer);
 
-    retval = fill_bucket(order);
-    if (!retval) {
-        buffer = find_buffer_in_bucket(order);
-        DEBUGASSERT(buffer);
-        return buffer;
+    while (bucket > order) {
+        bucket--;
+
+        buffer2 = (struct mm_buffer*) ((char*) buffer + order_to_size(bucket));
+        buffer2->bucket = bucket;
+#if defined(CONFIG_MM_BUFRAM_CANARY)
+        buffer2->canary = MM_CANARY;
+#endif
+        add_free_buffer(buffer2);
     }
 
-    return NULL;
+    buffer->bucket = order;
+#if defined(CONFIG_MM_BUFRAM_CANARY)
+    buffer->canary = MM_CANARY;
+#endif
+
+    return buffer;
 }
 
 void *bufram_alloc(size_t size)
@@ -234,26 +285,17 @@ void *bufram_alloc(size_t size)
 
     size += sizeof(*buffer);
     order = size_to_order(size);
-    if (order < 0)
-        return NULL;
-
     if (order > MM_BUCKET_MAX)
         return NULL;
 
     flags = irqsave();
-
     buffer = get_buffer(order);
-    if (!buffer)
-        goto error;
-
-    list_del(&buffer->list);
     irqrestore(flags);
 
-    return get_buffer_payload(buffer);
+    if (!buffer)
+        return NULL;
 
-error:
-    irqrestore(flags);
-    return NULL;
+    return get_buffer_payload(buffer);
 }
 
 void bufram_free(void *ptr)
@@ -265,7 +307,8 @@ void bufram_free(void *ptr)
         return;
 
     buffer = get_buffer_control_data(ptr);
-    if (buffer->list.prev != buffer->list.next) {
+    if (buffer->list.prev != buffer->list.next ||
+        buffer->bucket < MM_BUCKET_MIN || buffer->bucket > MM_BUCKET_MAX) {
         mm_warn("mm: trying to free invalid pointer: %p\n", ptr);
         return;
     }
@@ -279,7 +322,13 @@ void bufram_free(void *ptr)
 
     flags = irqsave();
 
-    list_add(&mm_bucket[buffer->bucket], &buffer->list);
+    if (is_buffer_free(buffer, buffer->bucket)) {
+        irqrestore(flags);
+        mm_warn("mm: double free: %p\n", ptr);
+        return;
+    }
+
+    add_free_buffer(buffer);
     defragment(buffer);
 
     irqrestore(flags);
@@ -64,6 +64,12 @@ FAR void *mm_calloc(FAR struct mm_heap_s *heap, size_t n, size_t elem_size)
   if (n > 0 && elem_size > 0)
     {
       ret = mm_zalloc(heap, n * elem_size);
+#ifdef CONFIG_MM_PROFILE
+      if (ret)
+        {
+          mm_profile_setcaller(heap, ret, __builtin_return_address(0));
+        }
+#endif
     }
 
   return ret;
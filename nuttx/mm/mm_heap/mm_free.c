@@ -84,15 +84,21 @@
  ****************************************************************************/
 
 /****************************************************************************
- * Name: mm_free
+ * Name: mm_free (or mm_heapfree)
  *
  * Description:
  *   Returns a chunk of memory to the list of free nodes,  merging with
- *   adjacent free chunks if possible.
+ *   adjacent free chunks if possible.  With CONFIG_MM_SIZE_CLASSES, this
+ *   is mm_heapfree() and mm_free() first offers the chunk to the size
+ *   class caches.
  *
  ****************************************************************************/
 
+#ifdef CONFIG_MM_SIZE_CLASSES
+void mm_heapfree(FAR struct mm_heap_s *heap, FAR void *mem)
+#else
 void mm_free(FAR struct mm_heap_s *heap, FAR void *mem)
+#endif
 {
   FAR struct mm_freenode_s *node;
   FAR struct mm_freenode_s *prev;
@@ -107,6 +113,10 @@ void mm_free(FAR struct mm_heap_s *heap, FAR void *mem)
       return;
     }
 
+#if defined(CONFIG_MM_PROFILE) && !defined(CONFIG_MM_SIZE_CLASSES)
+  mm_profile_free(heap, mem);
+#endif
+
   /* We need to hold the MM semaphore while we muck with the
    * nodelist.
    */
@@ -180,3 +190,33 @@ void mm_free(FAR struct mm_heap_s *heap, FAR void *mem)
   mm_addfreechunk(heap, node);
   mm_givesemaphore(heap);
 }
+
+/****************************************************************************
+ * Name: mm_free
+ *
+ * Description:
+ *   Returns a chunk of memory to its size class cache or, if it does not
+ *   fit there, to the heap.
+ *
+ ****************************************************************************/
+
+#ifdef CONFIG_MM_SIZE_CLASSES
+void mm_free(FAR struct mm_heap_s *heap, FAR void *mem)
+{
+  if (!mem)
+    {
+      return;
+    }
+
+#ifdef CONFIG_MM_PROFILE
+  /* Cached chunks are no longer accounted to their owner */
+
+  mm_profile_free(heap, mem);
+#endif
+
+  if (!mm_sizeclass_free(heap, mem))
+    {
+      mm_heapfree(heap, mem);
+    }
+}
+#endif
@@ -198,6 +198,16 @@ void mm_initialize(FAR struct mm_heap_s *heap, FAR void *heapstart,
       heap->mm_nodelist[i].blink   = &heap->mm_nodelist[i-1];
     }
 
+#ifdef CONFIG_MM_SIZE_CLASSES
+  /* The size class caches start empty */
+
+  memset(heap->mm_sizeclass, 0, sizeof(heap->mm_sizeclass));
+#endif
+
+#ifdef CONFIG_MM_PROFILE
+  mm_profile_initialize(heap);
+#endif
+
   /* Initialize the malloc semaphore to one (to support one-at-
    * a-time access to private data sets).
    */
@@ -76,6 +76,10 @@ int mm_mallinfo(FAR struct mm_heap_s *heap, FAR struct mallinfo *info)
   int    ordblks  = 0;  /* Number of non-inuse chunks */
   size_t uordblks = 0;  /* Total allocated space */
   size_t fordblks = 0;  /* Total non-inuse space */
+#ifdef CONFIG_MM_SIZE_CLASSES
+  size_t cached;        /* Space held in the size class caches */
+  size_t hits;          /* Allocations served from the caches */
+#endif
 #if CONFIG_MM_REGIONS > 1
   int region;
 #else
@@ -131,6 +135,17 @@ int mm_mallinfo(FAR struct mm_heap_s *heap, FAR struct mallinfo *info)
 
   DEBUGASSERT(uordblks + fordblks == heap->mm_heapsize);
 
+#ifdef CONFIG_MM_SIZE_CLASSES
+  /* Cached chunks look allocated to the heap but are free for the user */
+
+  mm_sizeclass_info(heap, &cached, &hits);
+  uordblks -= cached;
+  fordblks += cached;
+
+  info->cachedblks = cached;
+  info->cachehits  = hits;
+#endif
+
   info->arena    = heap->mm_heapsize;
   info->ordblks  = ordblks;
   info->mxordblk = mxordblk;
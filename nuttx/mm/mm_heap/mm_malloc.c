@@ -88,6 +88,9 @@ FAR void *mm_malloc(FAR struct mm_heap_s *heap, size_t size)
   FAR struct mm_freenode_s *node;
   void *ret = NULL;
   int ndx;
+#ifdef CONFIG_MM_SIZE_CLASSES
+  size_t request = size;
+#endif
 
   /* Handle bad sizes */
 
@@ -96,11 +99,33 @@ FAR void *mm_malloc(FAR struct mm_heap_s *heap, size_t size)
       return NULL;
     }
 
-  /* Adjust the size to account for (1) the size of the allocated node and
-   * (2) to make sure that it is an even multiple of our granule size.
+  /* Adjust the size to account for (1) the size of the allocated node,
+   * (2) the profiling tag, if any, and (3) to make sure that it is an even
+   * multiple of our granule size.
    */
 
-  size = MM_ALIGN_UP(size + SIZEOF_MM_ALLOCNODE);
+  size = MM_ALIGN_UP(size + SIZEOF_MM_ALLOCNODE + SIZEOF_MM_ALLOCTAG);
+
+#ifdef CONFIG_MM_SIZE_CLASSES
+  /* Small requests are first served from the size class caches, without
+   * taking the semaphore.  On a miss, round the size up to the class size
+   * so that the chunk can be cached when it is freed.
+   */
+
+  if (size <= MM_MAX_CLASS_CHUNK)
+    {
+      ret = mm_sizeclass_alloc(heap, size);
+      if (ret)
+        {
+#ifdef CONFIG_MM_PROFILE
+          mm_profile_alloc(heap, ret, __builtin_return_address(0));
+#endif
+          return ret;
+        }
+
+      size = mm_sizeclass_size(size);
+    }
+#endif
 
   /* We need to hold the MM semaphore while we muck with the nodelist. */
 
@@ -195,6 +220,33 @@ FAR void *mm_malloc(FAR struct mm_heap_s *heap, size_t size)
 
   mm_givesemaphore(heap);
 
+#ifdef CONFIG_MM_SIZE_CLASSES
+  /* The chunks held in the caches may be all that is missing.  Give them
+   * back to the heap and try once more.
+   */
+
+  if (!ret && mm_sizeclass_flush(heap) > 0)
+    {
+      ret = mm_malloc(heap, request);
+#ifdef CONFIG_MM_PROFILE
+      if (ret)
+        {
+          mm_profile_setcaller(heap, ret, __builtin_return_address(0));
+        }
+#endif
+      return ret;
+    }
+#endif
+
+#ifdef CONFIG_MM_PROFILE
+  /* Record the allocation against the running task and our caller */
+
+  if (ret)
+    {
+      mm_profile_alloc(heap, ret, __builtin_return_address(0));
+    }
+#endif
+
   /* If CONFIG_DEBUG_MM is defined, then output the result of the allocation
    * to the SYSLOG.
    */
@@ -76,6 +76,9 @@ FAR void *mm_memalign(FAR struct mm_heap_s *heap, size_t alignment,
   size_t alignedchunk;
   size_t mask = (size_t)(alignment - 1);
   size_t allocsize;
+#ifdef CONFIG_MM_PROFILE
+  struct mm_alloctag_s tag;
+#endif
 
   /* If this requested alinement's less than or equal to the natural alignment
    * of malloc, then just let malloc do the work.
@@ -83,7 +86,18 @@ FAR void *mm_memalign(FAR struct mm_heap_s *heap, size_t alignment,
 
   if (alignment <= MM_MIN_CHUNK)
     {
+#ifdef CONFIG_MM_PROFILE
+      rawchunk = (size_t)mm_malloc(heap, size);
+      if (rawchunk)
+        {
+          mm_profile_setcaller(heap, (FAR void *)rawchunk,
+                               __builtin_return_address(0));
+        }
+
+      return (FAR void *)rawchunk;
+#else
       return mm_malloc(heap, size);
+#endif
     }
 
   /* Adjust the size to account for (1) the size of the allocated node, (2)
@@ -95,10 +109,11 @@ FAR void *mm_memalign(FAR struct mm_heap_s *heap, size_t alignment,
    * alignment points within the allocated memory.
    *
    * NOTE:  These are sizes given to malloc and not chunk sizes. They do
-   * not include SIZEOF_MM_ALLOCNODE.
+   * not include SIZEOF_MM_ALLOCNODE.  They do include the profiling tag,
+   * if any, which must remain at the end of the final chunk.
    */
 
-  size      = MM_ALIGN_UP(size);   /* Make multiples of our granule size */
+  size      = MM_ALIGN_UP(size + SIZEOF_MM_ALLOCTAG); /* Granule multiples */
   allocsize = size + 2*alignment;  /* Add double full alignment size */
 
   /* Then malloc that size */
@@ -115,6 +130,12 @@ FAR void *mm_memalign(FAR struct mm_heap_s *heap, size_t alignment,
 
   mm_takesemaphore(heap);
 
+#ifdef CONFIG_MM_PROFILE
+  /* The chunk is about to be resized */
+
+  tag = mm_profile_detach(heap, (FAR void *)rawchunk);
+#endif
+
   /* Get the node associated with the allocation and the next node after
    * the allocation.
    */
@@ -209,6 +230,12 @@ FAR void *mm_memalign(FAR struct mm_heap_s *heap, size_t alignment,
       mm_shrinkchunk(heap, node, size + SIZEOF_MM_ALLOCNODE);
     }
 
+#ifdef CONFIG_MM_PROFILE
+  mm_profile_attach(heap, (FAR void *)alignedchunk, tag);
+  mm_profile_setcaller(heap, (FAR void *)alignedchunk,
+                       __builtin_return_address(0));
+#endif
+
   mm_givesemaphore(heap);
   return (FAR void*)alignedchunk;
 }
@@ -0,0 +1,427 @@
+/****************************************************************************
+ * mm/mm_heap/mm_profile.c
+ *
+ * Copyright (c) 2015 Google Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <debug.h>
+
+#include <arch/irq.h>
+#include <nuttx/sched.h>
+#include <nuttx/mm/mm.h>
+
+#ifdef CONFIG_MM_PROFILE
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Indexes of the entries collecting what did not fit in the tables */
+
+#define TASK_OVERFLOW CONFIG_MM_PROFILE_NTASKS
+#define SITE_OVERFLOW CONFIG_MM_PROFILE_NSITES
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static inline FAR struct mm_alloctag_s *mm_profile_tag(FAR void *mem)
+{
+  FAR struct mm_allocnode_s *node;
+
+  node = (FAR struct mm_allocnode_s *)((FAR char *)mem - SIZEOF_MM_ALLOCNODE);
+  return (FAR struct mm_alloctag_s *)
+    ((FAR char *)node + node->size - SIZEOF_MM_ALLOCTAG);
+}
+
+static inline size_t mm_profile_size(FAR void *mem)
+{
+  FAR struct mm_allocnode_s *node;
+
+  node = (FAR struct mm_allocnode_s *)((FAR char *)mem - SIZEOF_MM_ALLOCNODE);
+  return node->size;
+}
+
+/* Find or create the entry of the running task.  The entry of a task that
+ * has exited is reused once none of its memory is left allocated.  Called
+ * with interrupts disabled.
+ */
+
+static uint8_t mm_profile_task(FAR struct mm_profile_s *prof)
+{
+  FAR struct mm_proftask_s *task;
+  pid_t pid = getpid();
+  int ndx = -1;
+  int i;
+
+  for (i = 0; i < prof->ntasks; i++)
+    {
+      if (prof->task[i].pid == pid)
+        {
+          return i;
+        }
+
+      if (ndx < 0 && prof->task[i].pid < 0 && prof->task[i].count.live == 0)
+        {
+          ndx = i;
+        }
+    }
+
+  if (ndx < 0)
+    {
+      if (prof->ntasks >= CONFIG_MM_PROFILE_NTASKS)
+        {
+          return TASK_OVERFLOW;
+        }
+
+      ndx = prof->ntasks++;
+    }
+
+  task = &prof->task[ndx];
+  memset(task, 0, sizeof(struct mm_proftask_s));
+  task->pid = pid;
+#if CONFIG_TASK_NAME_SIZE > 0
+  strncpy(task->name, sched_self()->name, CONFIG_TASK_NAME_SIZE);
+  task->name[CONFIG_TASK_NAME_SIZE] = '\0';
+#endif
+
+  return ndx;
+}
+
+/* Find or create the entry of a call site, reusing an entry released by
+ * mm_profile_setcaller() if there is one.  Called with interrupts disabled.
+ */
+
+static uint8_t mm_profile_site(FAR struct mm_profile_s *prof,
+                               FAR void *caller)
+{
+  int ndx = -1;
+  int i;
+
+  for (i = 0; i < prof->nsites; i++)
+    {
+      if (prof->site[i].caller == caller)
+        {
+          return i;
+        }
+
+      if (ndx < 0 && prof->site[i].caller == NULL)
+        {
+          ndx = i;
+        }
+    }
+
+  if (ndx < 0)
+    {
+      if (prof->nsites >= CONFIG_MM_PROFILE_NSITES)
+        {
+          return SITE_OVERFLOW;
+        }
+
+      ndx = prof->nsites++;
+    }
+
+  prof->site[ndx].caller = caller;
+  return ndx;
+}
+
+static inline void mm_profile_add(FAR struct mm_profcount_s *count,
+                                  size_t size)
+{
+  count->live += size;
+  if (count->live > count->peak)
+    {
+      count->peak = count->live;
+    }
+}
+
+/* Account for 'size' more bytes owned by 'tag'.  Called with interrupts
+ * disabled.
+ */
+
+static void mm_profile_charge(FAR struct mm_profile_s *prof,
+                              struct mm_alloctag_s tag, size_t size)
+{
+  mm_profile_add(&prof->task[tag.task].count, size);
+  mm_profile_add(&prof->site[tag.site].count, size);
+
+  prof->live += size;
+  if (prof->live > prof->peak)
+    {
+      prof->peak = prof->live;
+    }
+}
+
+/* Read back the tag of an allocated chunk and account for the release of
+ * its bytes.  Called with interrupts disabled.
+ */
+
+static struct mm_alloctag_s mm_profile_uncharge(FAR struct mm_profile_s *prof,
+                                                FAR void *mem)
+{
+  struct mm_alloctag_s tag = *mm_profile_tag(mem);
+  size_t size = mm_profile_size(mem);
+
+  /* A tag overwritten by a buffer overrun must not take us out of the
+   * tables.
+   */
+
+  DEBUGASSERT(tag.task <= TASK_OVERFLOW && tag.site <= SITE_OVERFLOW);
+  if (tag.task > TASK_OVERFLOW)
+    {
+      tag.task = TASK_OVERFLOW;
+    }
+
+  if (tag.site > SITE_OVERFLOW)
+    {
+      tag.site = SITE_OVERFLOW;
+    }
+
+  prof->task[tag.task].count.live -= size;
+  prof->site[tag.site].count.live -= size;
+  prof->live -= size;
+
+  return tag;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: mm_profile_initialize
+ *
+ * Description:
+ *   Clear the allocation profile of a heap.
+ *
+ ****************************************************************************/
+
+void mm_profile_initialize(FAR struct mm_heap_s *heap)
+{
+  memset(&heap->mm_profile, 0, sizeof(struct mm_profile_s));
+  heap->mm_profile.task[TASK_OVERFLOW].pid = -1;
+}
+
+/****************************************************************************
+ * Name: mm_profile_alloc
+ *
+ * Description:
+ *   Account for a new allocation made by the running task from 'caller',
+ *   and tag the chunk with them.
+ *
+ ****************************************************************************/
+
+void mm_profile_alloc(FAR struct mm_heap_s *heap, FAR void *mem,
+                      FAR void *caller)
+{
+  FAR struct mm_profile_s *prof = &heap->mm_profile;
+  struct mm_alloctag_s tag;
+  irqstate_t flags;
+
+  flags = irqsave();
+
+  tag.task = mm_profile_task(prof);
+  tag.site = mm_profile_site(prof, caller);
+
+  prof->task[tag.task].count.nallocs++;
+  prof->site[tag.site].count.nallocs++;
+  mm_profile_charge(prof, tag, mm_profile_size(mem));
+
+  irqrestore(flags);
+
+  *mm_profile_tag(mem) = tag;
+}
+
+/****************************************************************************
+ * Name: mm_profile_free
+ *
+ * Description:
+ *   Account for the release of an allocation.
+ *
+ ****************************************************************************/
+
+void mm_profile_free(FAR struct mm_heap_s *heap, FAR void *mem)
+{
+  FAR struct mm_profile_s *prof = &heap->mm_profile;
+  struct mm_alloctag_s tag;
+  irqstate_t flags;
+
+  flags = irqsave();
+
+  tag = mm_profile_uncharge(prof, mem);
+  prof->task[tag.task].count.nfrees++;
+  prof->site[tag.site].count.nfrees++;
+
+  irqrestore(flags);
+}
+
+/****************************************************************************
+ * Name: mm_profile_detach
+ *
+ * Description:
+ *   Called before resizing or moving an allocated chunk (realloc,
+ *   memalign).  Returns the tag of the chunk, to be given back to
+ *   mm_profile_attach() once the chunk has its final size.
+ *
+ ****************************************************************************/
+
+struct mm_alloctag_s mm_profile_detach(FAR struct mm_heap_s *heap,
+                                       FAR void *mem)
+{
+  struct mm_alloctag_s tag;
+  irqstate_t flags;
+
+  flags = irqsave();
+  tag = mm_profile_uncharge(&heap->mm_profile, mem);
+  irqrestore(flags);
+
+  return tag;
+}
+
+/****************************************************************************
+ * Name: mm_profile_attach
+ *
+ * Description:
+ *   Account again for a chunk detached with mm_profile_detach(), now that
+ *   it has its final size and address.
+ *
+ ****************************************************************************/
+
+void mm_profile_attach(FAR struct mm_heap_s *heap, FAR void *mem,
+                       struct mm_alloctag_s tag)
+{
+  irqstate_t flags;
+
+  flags = irqsave();
+  mm_profile_charge(&heap->mm_profile, tag, mm_profile_size(mem));
+  irqrestore(flags);
+
+  *mm_profile_tag(mem) = tag;
+}
+
+/****************************************************************************
+ * Name: mm_profile_setcaller
+ *
+ * Description:
+ *   Move an allocation to another call site.  Used by the allocators built
+ *   on top of mm_malloc() (mm_zalloc(), mm_memalign(), ...) so that their
+ *   own callers are recorded instead of themselves.
+ *
+ ****************************************************************************/
+
+void mm_profile_setcaller(FAR struct mm_heap_s *heap, FAR void *mem,
+                          FAR void *caller)
+{
+  FAR struct mm_profile_s *prof = &heap->mm_profile;
+  FAR struct mm_profsite_s *site;
+  struct mm_alloctag_s tag;
+  irqstate_t flags;
+
+  flags = irqsave();
+
+  tag = mm_profile_uncharge(prof, mem);
+  site = &prof->site[tag.site];
+  site->count.nallocs--;
+
+  /* The allocator's own call site does not own anything anymore:  release
+   * its entry rather than having it hold a slot forever.
+   */
+
+  if (tag.site != SITE_OVERFLOW && site->count.nallocs == 0 &&
+      site->count.live == 0)
+    {
+      memset(site, 0, sizeof(struct mm_profsite_s));
+    }
+
+  tag.site = mm_profile_site(prof, caller);
+  prof->site[tag.site].count.nallocs++;
+  mm_profile_charge(prof, tag, mm_profile_size(mem));
+
+  irqrestore(flags);
+
+  *mm_profile_tag(mem) = tag;
+}
+
+/****************************************************************************
+ * Name: mm_profile_exit
+ *
+ * Description:
+ *   Called when a task exits.  Its entry keeps accounting for the memory
+ *   it left allocated, but is no longer matched by its pid, and is reused
+ *   for another task once that memory has been freed.
+ *
+ ****************************************************************************/
+
+void mm_profile_exit(FAR struct mm_heap_s *heap, pid_t pid)
+{
+  FAR struct mm_profile_s *prof = &heap->mm_profile;
+  irqstate_t flags;
+  int i;
+
+  flags = irqsave();
+
+  for (i = 0; i < prof->ntasks; i++)
+    {
+      if (prof->task[i].pid == pid)
+        {
+          prof->task[i].pid = -1;
+          break;
+        }
+    }
+
+  irqrestore(flags);
+}
+
+/****************************************************************************
+ * Name: mm_profile_snapshot
+ *
+ * Description:
+ *   Take a consistent copy of the allocation profile of a heap.
+ *
+ ****************************************************************************/
+
+void mm_profile_snapshot(FAR struct mm_heap_s *heap,
+                         FAR struct mm_profile_s *profile)
+{
+  irqstate_t flags;
+
+  flags = irqsave();
+  memcpy(profile, &heap->mm_profile, sizeof(struct mm_profile_s));
+  irqrestore(flags);
+}
+
+#endif /* CONFIG_MM_PROFILE */
@@ -91,6 +91,9 @@ FAR void *mm_realloc(FAR struct mm_heap_s *heap, FAR void *oldmem,
   size_t prevsize = 0;
   size_t nextsize = 0;
   FAR void *newmem;
+#ifdef CONFIG_MM_PROFILE
+  struct mm_alloctag_s tag;
+#endif
 
   /* If oldmem is NULL, then realloc is equivalent to malloc */
 
@@ -107,11 +110,12 @@ FAR void *mm_realloc(FAR struct mm_heap_s *heap, FAR void *oldmem,
       return NULL;
     }
 
-  /* Adjust the size to account for (1) the size of the allocated node and
-   * (2) to make sure that it is an even multiple of our granule size.
+  /* Adjust the size to account for (1) the size of the allocated node,
+   * (2) the profiling tag, if any, and (3) to make sure that it is an even
+   * multiple of our granule size.
    */
 
-  size = MM_ALIGN_UP(size + SIZEOF_MM_ALLOCNODE);
+  size = MM_ALIGN_UP(size + SIZEOF_MM_ALLOCNODE + SIZEOF_MM_ALLOCTAG);
 
   /* Map the memory chunk into an allocated node structure */
 
@@ -132,7 +136,13 @@ FAR void *mm_realloc(FAR struct mm_heap_s *heap, FAR void *oldmem,
 
       if (size < oldsize)
         {
+#ifdef CONFIG_MM_PROFILE
+          tag = mm_profile_detach(heap, oldmem);
           mm_shrinkchunk(heap, oldnode, size);
+          mm_profile_attach(heap, oldmem, tag);
+#else
+          mm_shrinkchunk(heap, oldnode, size);
+#endif
         }
 
       /* Then return the original address */
@@ -166,6 +176,12 @@ FAR void *mm_realloc(FAR struct mm_heap_s *heap, FAR void *oldmem,
       size_t takeprev = 0;
       size_t takenext = 0;
 
+#ifdef CONFIG_MM_PROFILE
+      /* The chunk is about to be resized and maybe moved */
+
+      tag = mm_profile_detach(heap, oldmem);
+#endif
+
       /* Check if we can extend into the previous chunk and if the
        * previous chunk is smaller than the next chunk.
        */
@@ -336,6 +352,10 @@ FAR void *mm_realloc(FAR struct mm_heap_s *heap, FAR void *oldmem,
             }
         }
 
+#ifdef CONFIG_MM_PROFILE
+      mm_profile_attach(heap, newmem, tag);
+#endif
+
       mm_givesemaphore(heap);
       return newmem;
     }
@@ -352,6 +372,9 @@ FAR void *mm_realloc(FAR struct mm_heap_s *heap, FAR void *oldmem,
       newmem = (FAR void*)mm_malloc(heap, size);
       if (newmem)
         {
+#ifdef CONFIG_MM_PROFILE
+          mm_profile_setcaller(heap, newmem, __builtin_return_address(0));
+#endif
           memcpy(newmem, oldmem, oldsize);
           mm_free(heap, oldmem);
         }
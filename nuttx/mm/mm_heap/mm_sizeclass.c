@@ -0,0 +1,232 @@
+/****************************************************************************
+ * mm/mm_heap/mm_sizeclass.c
+ *
+ * Copyright (c) 2015 Google Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <assert.h>
+#include <debug.h>
+
+#include <arch/irq.h>
+#include <nuttx/mm/mm.h>
+
+#ifdef CONFIG_MM_SIZE_CLASSES
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/* Index of the size class of an (aligned) chunk size, sizes above
+ * MM_MAX_CLASS_CHUNK excepted.
+ */
+
+static inline int mm_sizeclass_ndx(size_t size)
+{
+  if (size <= MM_MIN_CHUNK)
+    {
+      return 0;
+    }
+
+  return 32 - __builtin_clz(size - 1) - MM_MIN_SHIFT;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: mm_sizeclass_size
+ *
+ * Description:
+ *   Round a chunk size up to the size of its class, so that the chunk can
+ *   be cached when it is freed.
+ *
+ ****************************************************************************/
+
+size_t mm_sizeclass_size(size_t size)
+{
+  DEBUGASSERT(size <= MM_MAX_CLASS_CHUNK);
+  return MM_MIN_CHUNK << mm_sizeclass_ndx(size);
+}
+
+/****************************************************************************
+ * Name: mm_sizeclass_alloc
+ *
+ * Description:
+ *   Take a chunk of the class of 'size' (a chunk size, header included)
+ *   from the cache. Does not take the heap semaphore and can be called
+ *   from interrupt handlers. Returns NULL if that cache is empty.
+ *
+ ****************************************************************************/
+
+FAR void *mm_sizeclass_alloc(FAR struct mm_heap_s *heap, size_t size)
+{
+  FAR struct mm_sizeclass_s *sc;
+  FAR void *mem;
+  irqstate_t flags;
+
+  sc = &heap->mm_sizeclass[mm_sizeclass_ndx(size)];
+
+  flags = irqsave();
+
+  mem = sc->freelist;
+  if (mem)
+    {
+      sc->freelist = *(FAR void **)mem;
+      sc->count--;
+      sc->hits++;
+    }
+  else
+    {
+      sc->misses++;
+    }
+
+  irqrestore(flags);
+
+  return mem;
+}
+
+/****************************************************************************
+ * Name: mm_sizeclass_free
+ *
+ * Description:
+ *   Keep a freed chunk in the cache of its class. Returns false if the
+ *   chunk does not have the exact size of a class or if the cache is full,
+ *   in which case the chunk must go back to the heap.
+ *
+ ****************************************************************************/
+
+bool mm_sizeclass_free(FAR struct mm_heap_s *heap, FAR void *mem)
+{
+  FAR struct mm_allocnode_s *node;
+  FAR struct mm_sizeclass_s *sc;
+  irqstate_t flags;
+  size_t size;
+
+  node = (FAR struct mm_allocnode_s *)((char *)mem - SIZEOF_MM_ALLOCNODE);
+  size = node->size;
+
+  if (size > MM_MAX_CLASS_CHUNK || (size & (size - 1)) != 0)
+    {
+      return false;
+    }
+
+  sc = &heap->mm_sizeclass[mm_sizeclass_ndx(size)];
+
+  flags = irqsave();
+
+  if (sc->count >= CONFIG_MM_SIZE_CLASS_DEPTH)
+    {
+      irqrestore(flags);
+      return false;
+    }
+
+  /* The chunk stays marked as allocated for the heap */
+
+  *(FAR void **)mem = sc->freelist;
+  sc->freelist = mem;
+  sc->count++;
+
+  irqrestore(flags);
+
+  return true;
+}
+
+/****************************************************************************
+ * Name: mm_sizeclass_flush
+ *
+ * Description:
+ *   Give all the cached chunks back to the heap. Returns the number of
+ *   chunks released.
+ *
+ ****************************************************************************/
+
+int mm_sizeclass_flush(FAR struct mm_heap_s *heap)
+{
+  FAR struct mm_sizeclass_s *sc;
+  FAR void *mem;
+  FAR void *next;
+  irqstate_t flags;
+  int released = 0;
+  int ndx;
+
+  for (ndx = 0; ndx < MM_NCLASSES; ndx++)
+    {
+      sc = &heap->mm_sizeclass[ndx];
+
+      flags = irqsave();
+      mem = sc->freelist;
+      sc->freelist = NULL;
+      sc->count = 0;
+      irqrestore(flags);
+
+      for (; mem; mem = next)
+        {
+          next = *(FAR void **)mem;
+          mm_heapfree(heap, mem);
+          released++;
+        }
+    }
+
+  return released;
+}
+
+/****************************************************************************
+ * Name: mm_sizeclass_info
+ *
+ * Description:
+ *   Return the number of bytes held in the caches and the number of
+ *   allocations they served.
+ *
+ ****************************************************************************/
+
+void mm_sizeclass_info(FAR struct mm_heap_s *heap, FAR size_t *cached,
+                       FAR size_t *hits)
+{
+  irqstate_t flags;
+  int ndx;
+
+  *cached = 0;
+  *hits = 0;
+
+  flags = irqsave();
+  for (ndx = 0; ndx < MM_NCLASSES; ndx++)
+    {
+      *cached += heap->mm_sizeclass[ndx].count * (MM_MIN_CHUNK << ndx);
+      *hits += heap->mm_sizeclass[ndx].hits;
+    }
+  irqrestore(flags);
+}
+
+#endif /* CONFIG_MM_SIZE_CLASSES */
@@ -65,6 +65,9 @@ FAR void *mm_zalloc(FAR struct mm_heap_s *heap, size_t size)
   if (alloc)
     {
        memset(alloc, 0, size);
+#ifdef CONFIG_MM_PROFILE
+       mm_profile_setcaller(heap, alloc, __builtin_return_address(0));
+#endif
     }
 
   return alloc;
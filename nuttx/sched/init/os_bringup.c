@@ -193,6 +193,64 @@ static inline void os_pgworker(void)
 
 #endif /* CONFIG_PAGING */
 
+/****************************************************************************
+ * Name: os_workthreads
+ *
+ * Description:
+ *   Start the worker threads that service one kernel work queue.  All of
+ *   the threads share the queue; the first of them is the one that is
+ *   recorded as the queue's pid.
+ *
+ * Input Parameters:
+ *   qid       - The work queue ID
+ *   name      - The name of the worker threads
+ *   priority  - The priority of the worker threads
+ *   stacksize - The stack size of each worker thread
+ *   entry     - The worker thread entry point
+ *   nthreads  - The number of worker threads to start
+ *
+ * Returned Value:
+ *   None
+ *
+ ****************************************************************************/
+
+#if defined(CONFIG_SCHED_WORKQUEUE) && defined(CONFIG_SCHED_HPWORK)
+static inline void os_workthreads(int qid, FAR const char *name,
+                                  int priority, int stacksize,
+                                  main_t entry, int nthreads)
+{
+  FAR struct wqueue_s *wqueue = &g_work[qid];
+  pid_t pid;
+  int i;
+
+  /* Keep the new threads from running until they can find themselves in
+   * the worker list.
+   */
+
+  sched_lock();
+  for (i = 0; i < nthreads; i++)
+    {
+      pid = kernel_thread(name, priority, stacksize, entry,
+                          (FAR char * const *)NULL);
+      DEBUGASSERT(pid > 0);
+
+      if (i == 0)
+        {
+          wqueue->pid = pid;
+        }
+
+#if WORK_MAXTHREADS > 1
+      wqueue->worker[i] = pid;
+#endif
+    }
+
+#if WORK_MAXTHREADS > 1
+  wqueue->nthreads = nthreads;
+#endif
+  sched_unlock();
+}
+#endif
+
 /****************************************************************************
  * Name: os_workqueues
  *
@@ -221,11 +279,9 @@ static inline void os_workqueues(void)
   svdbg("Starting kernel worker thread\n");
 #endif
 
-  g_work[HPWORK].pid = kernel_thread(HPWORKNAME, CONFIG_SCHED_WORKPRIORITY,
-                                     CONFIG_SCHED_WORKSTACKSIZE,
-                                     (main_t)work_hpthread,
-                                     (FAR char * const *)NULL);
-  DEBUGASSERT(g_work[HPWORK].pid > 0);
+  os_workthreads(HPWORK, HPWORKNAME, CONFIG_SCHED_WORKPRIORITY,
+                 CONFIG_SCHED_WORKSTACKSIZE, (main_t)work_hpthread,
+                 CONFIG_SCHED_HPNTHREADS);
 
   /* Start a lower priority worker thread for other, non-critical continuation
    * tasks
@@ -235,11 +291,9 @@ static inline void os_workqueues(void)
 
   svdbg("Starting low-priority kernel worker thread\n");
 
-  g_work[LPWORK].pid = kernel_thread(LPWORKNAME, CONFIG_SCHED_LPWORKPRIORITY,
-                                     CONFIG_SCHED_LPWORKSTACKSIZE,
-                                     (main_t)work_lpthread,
-                                     (FAR char * const *)NULL);
-  DEBUGASSERT(g_work[LPWORK].pid > 0);
+  os_workthreads(LPWORK, LPWORKNAME, CONFIG_SCHED_LPWORKPRIORITY,
+                 CONFIG_SCHED_LPWORKSTACKSIZE, (main_t)work_lpthread,
+                 CONFIG_SCHED_LPNTHREADS);
 
 #endif /* CONFIG_SCHED_LPWORK */
 #endif /* CONFIG_SCHED_HPWORK */
@@ -355,6 +355,9 @@ void os_start(void)
   /* Then add the idle task's TCB to the head of the ready to run list */
 
   dq_addfirst((FAR dq_entry_t*)&g_idletcb, (FAR dq_queue_t*)&g_readytorun);
+#ifdef CONFIG_SCHED_READYMAP
+  sched_readymap_set(&g_idletcb.cmn);
+#endif
 
   /* Initialize the processor-specific portion of the TCB */
 
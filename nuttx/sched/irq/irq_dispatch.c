@@ -70,6 +70,7 @@
 #include <debug.h>
 #include <nuttx/arch.h>
 #include <nuttx/irq.h>
+#include <nuttx/sched_trace.h>
 
 #include "irq/irq.h"
 
@@ -120,6 +121,8 @@ void irq_dispatch(int irq, FAR void *context)
   sched_track_irq_start(irq);
 #endif
 
+  sched_trace_irqenter(irq);
+
   /* Perform some sanity checks */
 
 #if NR_IRQS > 0
@@ -139,6 +142,8 @@ void irq_dispatch(int irq, FAR void *context)
 
   vector(irq, context, g_irqpriv[irq]);
 
+  sched_trace_irqleave(irq);
+
 #if defined(CONFIG_USEC_MEASURE_PERF)
   /* stop tracking current interrupt and go back to tracking current tcb */
   sched_track_irq_stop();
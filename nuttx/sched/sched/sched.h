@@ -77,6 +77,7 @@
 #include <sched.h>
 
 #include <nuttx/kmalloc.h>
+#include <nuttx/sched_trace.h>
 
 /****************************************************************************
  * Pre-processor Definitions
@@ -256,6 +257,11 @@ bool sched_addreadytorun(FAR struct tcb_s *rtrtcb);
 bool sched_removereadytorun(FAR struct tcb_s *rtrtcb);
 bool sched_addprioritized(FAR struct tcb_s *newTcb, DSEG dq_queue_t *list);
 bool sched_mergepending(void);
+#ifdef CONFIG_SCHED_READYMAP
+bool sched_readymap_insert(FAR struct tcb_s *tcb);
+void sched_readymap_set(FAR struct tcb_s *tcb);
+void sched_readymap_clear(FAR struct tcb_s *tcb);
+#endif
 void sched_addblocked(FAR struct tcb_s *btcb, tstate_t task_state);
 void sched_removeblocked(FAR struct tcb_s *btcb);
 int  sched_setpriority(FAR struct tcb_s *tcb, int sched_priority);
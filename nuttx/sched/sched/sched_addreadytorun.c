@@ -121,11 +121,16 @@ bool sched_addreadytorun(FAR struct tcb_s *btcb)
 
   /* Otherwise, add the new task to the ready-to-run task list */
 
+#ifdef CONFIG_SCHED_READYMAP
+  else if (sched_readymap_insert(btcb))
+#else
   else if (sched_addprioritized(btcb, (FAR dq_queue_t*)&g_readytorun))
+#endif
     {
       /* Inform the instrumentation logic that we are switching tasks */
 
       sched_note_switch(rtcb, btcb);
+      sched_trace_switch(rtcb, btcb);
 
       /* The new btcb was added at the head of the ready-to-run list.  It
        * is now to new active task!
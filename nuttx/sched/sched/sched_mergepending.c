@@ -92,6 +92,50 @@
  *
  ************************************************************************/
 
+#ifdef CONFIG_SCHED_READYMAP
+bool sched_mergepending(void)
+{
+  FAR struct tcb_s *pndtcb;
+  FAR struct tcb_s *pndnext;
+  FAR struct tcb_s *rtrtcb;
+  bool ret = false;
+
+  /* Process every TCB in the g_pendingtasks list.  The ready-to-run index
+   * finds the insertion point of each one without searching the list.
+   */
+
+  for (pndtcb = (FAR struct tcb_s*)g_pendingtasks.head; pndtcb; pndtcb = pndnext)
+    {
+      pndnext = pndtcb->flink;
+      rtrtcb  = (FAR struct tcb_s*)g_readytorun.head;
+
+      if (sched_readymap_insert(pndtcb))
+        {
+          /* pndtcb was inserted at the head of the list.  Inform the
+           * instrumentation layer that we are switching tasks.
+           */
+
+          sched_note_switch(rtrtcb, pndtcb);
+          sched_trace_switch(rtrtcb, pndtcb);
+
+          rtrtcb->task_state = TSTATE_TASK_READYTORUN;
+          pndtcb->task_state = TSTATE_TASK_RUNNING;
+          ret                = true;
+        }
+      else
+        {
+          pndtcb->task_state = TSTATE_TASK_READYTORUN;
+        }
+    }
+
+  /* Mark the input list empty */
+
+  g_pendingtasks.head = NULL;
+  g_pendingtasks.tail = NULL;
+
+  return ret;
+}
+#else
 bool sched_mergepending(void)
 {
   FAR struct tcb_s *pndtcb;
@@ -136,6 +180,7 @@ bool sched_mergepending(void)
           /* Inform the instrumentation layer that we are switching tasks */
 
           sched_note_switch(rtrtcb, pndtcb);
+          sched_trace_switch(rtrtcb, pndtcb);
 
           /* Then insert at the head of the list */
 
@@ -170,3 +215,4 @@ bool sched_mergepending(void)
 
   return ret;
 }
+#endif /* CONFIG_SCHED_READYMAP */
@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <queue.h>
+#include <assert.h>
+
+#include "sched/sched.h"
+
+#ifdef CONFIG_SCHED_READYMAP
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define READYMAP_NPRIOS  (SCHED_PRIORITY_MAX + 1)
+#define READYMAP_NWORDS  ((READYMAP_NPRIOS + 31) >> 5)
+
+/****************************************************************************
+ * Private Variables
+ ****************************************************************************/
+
+/* One bit per priority that has at least one TCB in g_readytorun, and one
+ * summary bit per non-empty word of g_readymap.
+ */
+
+static uint32_t g_readymap[READYMAP_NWORDS];
+static uint32_t g_readysummary;
+
+/* The last (most recently queued) TCB of each priority in g_readytorun.
+ * New TCBs are linked in right after it, which keeps tasks of equal
+ * priority in FIFO order as sched_addprioritized() does.
+ */
+
+static FAR struct tcb_s *g_readytail[READYMAP_NPRIOS];
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: sched_readymap_prev
+ *
+ * Description:
+ *   Return the TCB that a new TCB of the given priority must follow in
+ *   g_readytorun: the tail of the lowest non-empty priority that is not
+ *   below it.  NULL means the new TCB goes at the head of the list.
+ *
+ ****************************************************************************/
+
+static FAR struct tcb_s *sched_readymap_prev(uint8_t priority)
+{
+  unsigned int word = priority >> 5;
+  uint32_t bits;
+
+  bits = g_readymap[word] & ~(((uint32_t)1 << (priority & 31)) - 1);
+  if (!bits)
+    {
+      /* Nothing at or above this priority in its word; move on to the
+       * lowest non-empty word above it.
+       */
+
+      bits = g_readysummary & ~(((uint32_t)2 << word) - 1);
+      if (!bits)
+        {
+          return NULL;
+        }
+
+      word = __builtin_ctz(bits);
+      bits = g_readymap[word];
+    }
+
+  return g_readytail[(word << 5) + __builtin_ctz(bits)];
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: sched_readymap_set
+ *
+ * Description:
+ *   Record that tcb is now the last TCB of its priority in g_readytorun.
+ *
+ * Assumptions:
+ * - The caller has established a critical section.
+ * - tcb is already linked into g_readytorun after every other TCB of the
+ *   same priority.
+ *
+ ****************************************************************************/
+
+void sched_readymap_set(FAR struct tcb_s *tcb)
+{
+  uint8_t priority = tcb->sched_priority;
+
+  g_readytail[priority]     = tcb;
+  g_readymap[priority >> 5] |= (uint32_t)1 << (priority & 31);
+  g_readysummary           |= (uint32_t)1 << (priority >> 5);
+}
+
+/****************************************************************************
+ * Name: sched_readymap_clear
+ *
+ * Description:
+ *   Drop tcb from the ready-to-run index.  This must be called before tcb
+ *   is unlinked from g_readytorun and before its sched_priority changes.
+ *
+ * Assumptions:
+ * - The caller has established a critical section.
+ *
+ ****************************************************************************/
+
+void sched_readymap_clear(FAR struct tcb_s *tcb)
+{
+  uint8_t priority = tcb->sched_priority;
+  FAR struct tcb_s *prev;
+
+  if (g_readytail[priority] != tcb)
+    {
+      /* Not the last of its priority; the index does not change */
+
+      return;
+    }
+
+  prev = (FAR struct tcb_s *)tcb->blink;
+  if (prev && prev->sched_priority == priority)
+    {
+      g_readytail[priority] = prev;
+      return;
+    }
+
+  /* tcb was the only TCB of its priority */
+
+  g_readytail[priority] = NULL;
+  g_readymap[priority >> 5] &= ~((uint32_t)1 << (priority & 31));
+  if (!g_readymap[priority >> 5])
+    {
+      g_readysummary &= ~((uint32_t)1 << (priority >> 5));
+    }
+}
+
+/****************************************************************************
+ * Name: sched_readymap_insert
+ *
+ * Description:
+ *   Link tcb into g_readytorun after every TCB of higher or equal priority
+ *   and update the index.  This is the constant-time equivalent of
+ *   sched_addprioritized(tcb, &g_readytorun).
+ *
+ * Return Value:
+ *   true if the head of g_readytorun has changed.
+ *
+ * Assumptions:
+ * - The caller has established a critical section.
+ * - tcb is not in any list.
+ *
+ ****************************************************************************/
+
+bool sched_readymap_insert(FAR struct tcb_s *tcb)
+{
+  FAR struct tcb_s *prev;
+  FAR struct tcb_s *next;
+  bool ret = false;
+
+  ASSERT(tcb->sched_priority >= SCHED_PRIORITY_MIN);
+
+  prev = sched_readymap_prev(tcb->sched_priority);
+  if (!prev)
+    {
+      /* Insert at the head of the list */
+
+      next = (FAR struct tcb_s *)g_readytorun.head;
+      g_readytorun.head = (FAR dq_entry_t *)tcb;
+      ret = true;
+    }
+  else
+    {
+      next = prev->flink;
+      prev->flink = tcb;
+    }
+
+  tcb->blink = prev;
+  tcb->flink = next;
+
+  if (next)
+    {
+      next->blink = tcb;
+    }
+  else
+    {
+      g_readytorun.tail = (FAR dq_entry_t *)tcb;
+    }
+
+  sched_readymap_set(tcb);
+  return ret;
+}
+
+#endif /* CONFIG_SCHED_READYMAP */
@@ -109,12 +109,16 @@ bool sched_removereadytorun(FAR struct tcb_s *rtcb)
       /* Inform the instrumentation layer that we are switching tasks */
 
       sched_note_switch(rtcb, ntcb);
+      sched_trace_switch(rtcb, ntcb);
       ntcb->task_state = TSTATE_TASK_RUNNING;
       ret = true;
     }
 
   /* Remove the TCB from the ready-to-run list */
 
+#ifdef CONFIG_SCHED_READYMAP
+  sched_readymap_clear(rtcb);
+#endif
   dq_rem((FAR dq_entry_t *)rtcb, (FAR dq_queue_t *)&g_readytorun);
 
   /* Since the TCB is not in any list, it is now invalid */
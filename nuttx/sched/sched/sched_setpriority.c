@@ -149,9 +149,17 @@ int sched_setpriority(FAR struct tcb_s *tcb, int sched_priority)
 
         else
           {
-            /* Change the task priority */
+            /* Change the task priority.  The task stays at the head of the
+             * list, but the ready-to-run index is keyed by priority.
+             */
 
+#ifdef CONFIG_SCHED_READYMAP
+            sched_readymap_clear(tcb);
+#endif
             tcb->sched_priority = (uint8_t)sched_priority;
+#ifdef CONFIG_SCHED_READYMAP
+            sched_readymap_set(tcb);
+#endif
           }
         break;
 
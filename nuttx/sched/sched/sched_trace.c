@@ -0,0 +1,185 @@
+/****************************************************************************
+ * sched/sched/sched_trace.c
+ *
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <nuttx/arch.h>
+#include <nuttx/hires_tmr.h>
+#include <nuttx/sched_trace.h>
+#include <arch/irq.h>
+
+#include "sched/sched.h"
+
+#ifdef CONFIG_SCHED_TRACE
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define TRACE_MASK  (CONFIG_SCHED_TRACE_NRECORDS - 1)
+
+/****************************************************************************
+ * Private Variables
+ ****************************************************************************/
+
+/* The trace ring.  It is filled from boot on and is never drained: a dump
+ * only copies it, and the oldest records are overwritten once it is full.
+ */
+
+static struct sched_trace_s g_trace[CONFIG_SCHED_TRACE_NRECORDS];
+
+/* Number of records written since boot, and whether the ring has been
+ * filled at least once (g_tracecount may have wrapped around since).
+ */
+
+static uint32_t g_tracecount;
+static bool g_tracefull;
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: sched_trace
+ *
+ * Description:
+ *   Add one record to the trace ring, overwriting the oldest record if the
+ *   ring is full.  May be called from interrupt handlers.
+ *
+ ****************************************************************************/
+
+void sched_trace(uint8_t type, uint8_t arg8, uint16_t arg16, uint32_t data)
+{
+  FAR struct sched_trace_s *rec;
+  irqstate_t flags;
+
+  flags = irqsave();
+
+  rec        = &g_trace[g_tracecount & TRACE_MASK];
+  rec->time  = hrt_getusec();
+  rec->type  = type;
+  rec->arg8  = arg8;
+  rec->arg16 = arg16;
+  rec->data  = data;
+
+  if ((++g_tracecount & TRACE_MASK) == 0)
+    {
+      g_tracefull = true;
+    }
+
+  irqrestore(flags);
+}
+
+/****************************************************************************
+ * Name: sched_trace_switch
+ *
+ * Description:
+ *   Record that the task at the head of the ready-to-run list changes from
+ *   'from' to 'to'.
+ *
+ * Assumptions:
+ *   Called from the scheduler with interrupts disabled.
+ *
+ ****************************************************************************/
+
+void sched_trace_switch(FAR struct tcb_s *from, FAR struct tcb_s *to)
+{
+  sched_trace(SCHED_TRACE_SWITCH, to->sched_priority, from->pid, to->pid);
+}
+
+/****************************************************************************
+ * Name: sched_trace_dump
+ *
+ * Description:
+ *   Take a consistent copy of the trace ring.
+ *
+ * Input Parameters:
+ *   hdr      - Receives the header of the dump
+ *   buffer   - Receives the records, oldest first
+ *   nrecords - Room in buffer, in records.  Only the most recent records
+ *              are copied if it is smaller than the ring.
+ *
+ * Returned Value:
+ *   The number of records copied, also found in hdr->nrecords.
+ *
+ ****************************************************************************/
+
+size_t sched_trace_dump(FAR struct sched_trace_header_s *hdr,
+                        FAR struct sched_trace_s *buffer, size_t nrecords)
+{
+  irqstate_t flags;
+  uint32_t available;
+  uint32_t first;
+  size_t chunk;
+
+  flags = irqsave();
+
+  available = g_tracefull ? CONFIG_SCHED_TRACE_NRECORDS : g_tracecount;
+  if (nrecords > available)
+    {
+      nrecords = available;
+    }
+
+  /* Copy the most recent records, which may wrap around the end of the
+   * ring.
+   */
+
+  first = (g_tracecount - nrecords) & TRACE_MASK;
+  chunk = CONFIG_SCHED_TRACE_NRECORDS - first;
+  if (chunk > nrecords)
+    {
+      chunk = nrecords;
+    }
+
+  memcpy(buffer, &g_trace[first], chunk * sizeof(struct sched_trace_s));
+  memcpy(buffer + chunk, g_trace,
+         (nrecords - chunk) * sizeof(struct sched_trace_s));
+
+  hdr->magic    = SCHED_TRACE_MAGIC;
+  hdr->version  = SCHED_TRACE_VERSION;
+  hdr->recsize  = sizeof(struct sched_trace_s);
+  hdr->nrecords = nrecords;
+  hdr->lost     = g_tracecount - nrecords;
+  hdr->time     = hrt_getusec();
+
+  irqrestore(flags);
+  return nrecords;
+}
+
+#endif /* CONFIG_SCHED_TRACE */
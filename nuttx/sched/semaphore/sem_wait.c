@@ -169,6 +169,7 @@ int sem_wait(FAR sem_t *sem)
           /* Add the TCB to the prioritized semaphore wait queue */
 
           set_errno(0);
+          sched_trace_semwait(rtcb, sem);
           up_block_task(rtcb, TSTATE_WAIT_SEM);
 
           /* When we resume at this point, either (1) the semaphore has been
@@ -47,6 +47,7 @@
 
 #include <nuttx/sched.h>
 #include <nuttx/fs/fs.h>
+#include <nuttx/mm/mm.h>
 
 #include "sched/sched.h"
 #include "group/group.h"
@@ -683,6 +684,12 @@ void task_exithook(FAR struct tcb_s *tcb, int status, bool nonblocking)
   sig_cleanup(tcb); /* Deallocate Signal lists */
 #endif
 
+#if defined(CONFIG_MM_PROFILE) && !defined(CONFIG_BUILD_PROTECTED)
+  /* Stop accounting the allocations of this pid to the exiting task */
+
+  mm_profile_exit(&g_mmheap, tcb->pid);
+#endif
+
   /* This function can be re-entered in certain cases.  Set a flag
    * bit in the TCB to not that we have already completed this exit
    * processing.
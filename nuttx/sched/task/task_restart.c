@@ -160,6 +160,12 @@ int task_restart(pid_t pid)
        */
 
       state = irqsave();
+#ifdef CONFIG_SCHED_READYMAP
+      if (tcb->cmn.task_state == TSTATE_TASK_READYTORUN)
+        {
+          sched_readymap_clear((FAR struct tcb_s *)tcb);
+        }
+#endif
       dq_rem((FAR dq_entry_t*)tcb,
              (dq_queue_t*)g_tasklisttable[tcb->cmn.task_state].list);
       tcb->cmn.task_state = TSTATE_TASK_INVALID;
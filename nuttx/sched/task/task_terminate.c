@@ -168,6 +168,12 @@ int task_terminate(pid_t pid, bool nonblocking)
   /* Remove the task from the OS's tasks lists. */
 
   saved_state = irqsave();
+#ifdef CONFIG_SCHED_READYMAP
+  if (dtcb->task_state == TSTATE_TASK_READYTORUN)
+    {
+      sched_readymap_clear(dtcb);
+    }
+#endif
   dq_rem((FAR dq_entry_t*)dtcb, (dq_queue_t*)g_tasklisttable[dtcb->task_state].list);
   dtcb->task_state = TSTATE_TASK_INVALID;
   irqrestore(saved_state);
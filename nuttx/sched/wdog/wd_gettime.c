@@ -94,6 +94,12 @@ int wd_gettime(WDOG_ID wdog)
   flags = irqsave();
   if (wdog && WDOG_ISACTIVE(wdog))
     {
+#ifdef CONFIG_WDOG_TIMERWHEEL
+      int delay = (int)(wdog->expiry - g_wdnow);
+
+      irqrestore(flags);
+      return delay;
+#else
       /* Traverse the watchdog list accumulating lag times until we find the wdog
        * that we are looking for
        */
@@ -110,6 +116,7 @@ int wd_gettime(WDOG_ID wdog)
               return delay;
             }
         }
+#endif
     }
 
   irqrestore(flags);
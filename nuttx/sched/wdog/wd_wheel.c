@@ -0,0 +1,352 @@
+/****************************************************************************
+ * sched/wdog/wd_wheel.c
+ *
+ * Copyright (c) 2015 Google, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdint.h>
+
+#include <nuttx/wdog.h>
+
+#include "wdog/wdog.h"
+
+#ifdef CONFIG_WDOG_TIMERWHEEL
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define WHEEL_MASK          (WDOG_WHEEL_SLOTS - 1)
+#define WHEEL_SHIFT(l)      ((l) * WDOG_WHEEL_BITS)
+#define WHEEL_BUCKET(l, s)  ((l) * WDOG_WHEEL_SLOTS + (s))
+
+/****************************************************************************
+ * Public Variables
+ ****************************************************************************/
+
+/* The current time of the timer wheel, in ticks.  It is advanced by
+ * wd_timer() and is the reference for the absolute expiration times kept in
+ * each active watchdog.
+ */
+
+uint32_t g_wdnow;
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+/* Each bucket is a circular, doubly linked list of watchdogs: the bucket
+ * points to the oldest entry and that entry's prev field to the newest one.
+ * A watchdog whose expiration time differs from g_wdnow first in bit group
+ * 'l' sits in level 'l', in the slot given by that bit group of its
+ * expiration time.  Watchdogs too far in the future for the wheel wait in
+ * the extra overflow bucket.
+ */
+
+static FAR struct wdog_s *g_wdbucket[WDOG_WHEEL_NBUCKETS + 1];
+
+/* One bit per non-empty slot of each level */
+
+static uint32_t g_wdslotmap[WDOG_WHEEL_LEVELS];
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: wd_bucket_add
+ ****************************************************************************/
+
+static void wd_bucket_add(FAR struct wdog_s *wdog, unsigned int bucket)
+{
+  FAR struct wdog_s *first = g_wdbucket[bucket];
+
+  if (!first)
+    {
+      wdog->next = wdog;
+      wdog->prev = wdog;
+      g_wdbucket[bucket] = wdog;
+
+      if (bucket < WDOG_WHEEL_NBUCKETS)
+        {
+          g_wdslotmap[bucket / WDOG_WHEEL_SLOTS] |=
+            (uint32_t)1 << (bucket & WHEEL_MASK);
+        }
+    }
+  else
+    {
+      /* Append, so that watchdogs expiring on the same tick run in the
+       * order they were started.
+       */
+
+      wdog->next        = first;
+      wdog->prev        = first->prev;
+      first->prev->next = wdog;
+      first->prev       = wdog;
+    }
+
+  wdog->bucket = bucket;
+}
+
+/****************************************************************************
+ * Name: wd_bucket_detach
+ *
+ * Description:
+ *   Empty a bucket and return its list of watchdogs.
+ *
+ ****************************************************************************/
+
+static FAR struct wdog_s *wd_bucket_detach(unsigned int bucket)
+{
+  FAR struct wdog_s *first = g_wdbucket[bucket];
+
+  if (first)
+    {
+      first->prev->next  = NULL;
+      g_wdbucket[bucket] = NULL;
+
+      if (bucket < WDOG_WHEEL_NBUCKETS)
+        {
+          g_wdslotmap[bucket / WDOG_WHEEL_SLOTS] &=
+            ~((uint32_t)1 << (bucket & WHEEL_MASK));
+        }
+    }
+
+  return first;
+}
+
+/****************************************************************************
+ * Name: wd_bucket_cascade
+ *
+ * Description:
+ *   Re-insert every watchdog of a bucket relative to the current time.
+ *   This moves them down the wheel as their expiration time approaches.
+ *
+ ****************************************************************************/
+
+static void wd_bucket_cascade(unsigned int bucket)
+{
+  FAR struct wdog_s *wdog;
+  FAR struct wdog_s *next;
+
+  for (wdog = wd_bucket_detach(bucket); wdog; wdog = next)
+    {
+      next = wdog->next;
+      wd_wheel_add(wdog);
+    }
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: wd_wheel_add
+ *
+ * Description:
+ *   Insert an active watchdog in the timer wheel according to its
+ *   absolute expiration time.
+ *
+ * Assumptions:
+ *   Interrupts are disabled.  wdog->expiry is later than g_wdnow.
+ *
+ ****************************************************************************/
+
+void wd_wheel_add(FAR struct wdog_s *wdog)
+{
+  uint32_t diff = wdog->expiry ^ g_wdnow;
+  unsigned int level;
+
+  if (diff >= WDOG_WHEEL_SPAN)
+    {
+      wd_bucket_add(wdog, WDOG_WHEEL_OVERFLOW);
+      return;
+    }
+
+  for (level = 0; diff >= WDOG_WHEEL_SLOTS; level++)
+    {
+      diff >>= WDOG_WHEEL_BITS;
+    }
+
+  wd_bucket_add(wdog, WHEEL_BUCKET(level,
+                (wdog->expiry >> WHEEL_SHIFT(level)) & WHEEL_MASK));
+}
+
+/****************************************************************************
+ * Name: wd_wheel_remove
+ *
+ * Description:
+ *   Remove an active watchdog from the timer wheel.
+ *
+ * Assumptions:
+ *   Interrupts are disabled.
+ *
+ ****************************************************************************/
+
+void wd_wheel_remove(FAR struct wdog_s *wdog)
+{
+  unsigned int bucket = wdog->bucket;
+
+  if (wdog->next == wdog)
+    {
+      (void)wd_bucket_detach(bucket);
+    }
+  else
+    {
+      wdog->prev->next = wdog->next;
+      wdog->next->prev = wdog->prev;
+
+      if (g_wdbucket[bucket] == wdog)
+        {
+          g_wdbucket[bucket] = wdog->next;
+        }
+    }
+
+  wdog->prev = NULL;
+}
+
+/****************************************************************************
+ * Name: wd_wheel_cascade
+ *
+ * Description:
+ *   Move the watchdogs whose time window begins at g_wdnow down the wheel.
+ *   This must be done before wd_wheel_expired() each time g_wdnow reaches
+ *   the start of a slot in an upper level.
+ *
+ * Assumptions:
+ *   Interrupts are disabled.
+ *
+ ****************************************************************************/
+
+void wd_wheel_cascade(void)
+{
+  uint32_t now = g_wdnow;
+  int level;
+
+  if ((now & (WDOG_WHEEL_SPAN - 1)) == 0)
+    {
+      wd_bucket_cascade(WDOG_WHEEL_OVERFLOW);
+    }
+
+  /* Work from the top down so that watchdogs dropping from one level into
+   * a slot being cascaded below are moved again in the same pass.
+   */
+
+  for (level = WDOG_WHEEL_LEVELS - 1; level > 0; level--)
+    {
+      if ((now & (((uint32_t)1 << WHEEL_SHIFT(level)) - 1)) == 0)
+        {
+          wd_bucket_cascade(WHEEL_BUCKET(level,
+                            (now >> WHEEL_SHIFT(level)) & WHEEL_MASK));
+        }
+    }
+}
+
+/****************************************************************************
+ * Name: wd_wheel_expired
+ *
+ * Description:
+ *   Remove and return one watchdog that expires at g_wdnow, or NULL if there
+ *   is none left.
+ *
+ * Assumptions:
+ *   Interrupts are disabled.
+ *
+ ****************************************************************************/
+
+FAR struct wdog_s *wd_wheel_expired(void)
+{
+  FAR struct wdog_s *wdog = g_wdbucket[WHEEL_BUCKET(0, g_wdnow & WHEEL_MASK)];
+
+  if (wdog)
+    {
+      wd_wheel_remove(wdog);
+    }
+
+  return wdog;
+}
+
+/****************************************************************************
+ * Name: wd_wheel_next
+ *
+ * Description:
+ *   Return the number of ticks from g_wdnow to the next time at which the
+ *   wheel needs attention: a watchdog expiration or the start of an
+ *   occupied slot that must be cascaded.  Time may be advanced by up to
+ *   that amount without calling wd_wheel_cascade() or wd_wheel_expired().
+ *
+ * Return Value:
+ *   The number of ticks, or zero if there are no active watchdogs.
+ *
+ * Assumptions:
+ *   Interrupts are disabled.
+ *
+ ****************************************************************************/
+
+unsigned int wd_wheel_next(void)
+{
+  uint32_t now = g_wdnow;
+  uint32_t slots;
+  uint32_t start;
+  unsigned int shift;
+  int level;
+
+  /* Slots are ordered in time within a level, and every watchdog in a level
+   * expires before any in the levels above.
+   */
+
+  for (level = 0; level < WDOG_WHEEL_LEVELS; level++)
+    {
+      shift = WHEEL_SHIFT(level);
+      slots = g_wdslotmap[level] &
+              ((uint32_t)~0 << ((now >> shift) & WHEEL_MASK));
+
+      if (slots)
+        {
+          start  = (now >> (shift + WDOG_WHEEL_BITS)) <<
+                   (shift + WDOG_WHEEL_BITS);
+          start |= (uint32_t)__builtin_ctz(slots) << shift;
+          return start - now;
+        }
+    }
+
+  if (g_wdbucket[WDOG_WHEEL_OVERFLOW])
+    {
+      return WDOG_WHEEL_SPAN - (now & (WDOG_WHEEL_SPAN - 1));
+    }
+
+  return 0;
+}
+
+#endif /* CONFIG_WDOG_TIMERWHEEL */
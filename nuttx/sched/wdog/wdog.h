@@ -52,6 +52,19 @@
  * Pre-processor Definitions
  ************************************************************************/
 
+#ifdef CONFIG_WDOG_TIMERWHEEL
+/* Timer wheel geometry: WDOG_WHEEL_LEVELS levels of WDOG_WHEEL_SLOTS slots,
+ * covering WDOG_WHEEL_SPAN ticks.  Longer delays wait in an overflow bucket.
+ */
+
+#  define WDOG_WHEEL_BITS      5
+#  define WDOG_WHEEL_SLOTS     (1 << WDOG_WHEEL_BITS)
+#  define WDOG_WHEEL_LEVELS    5
+#  define WDOG_WHEEL_NBUCKETS  (WDOG_WHEEL_LEVELS * WDOG_WHEEL_SLOTS)
+#  define WDOG_WHEEL_OVERFLOW  WDOG_WHEEL_NBUCKETS
+#  define WDOG_WHEEL_SPAN      ((uint32_t)1 << (WDOG_WHEEL_BITS * WDOG_WHEEL_LEVELS))
+#endif
+
 /************************************************************************
  * Public Type Declarations
  ************************************************************************/
@@ -81,6 +94,14 @@ extern sq_queue_t g_wdfreelist;
 
 extern sq_queue_t g_wdactivelist;
 
+#ifdef CONFIG_WDOG_TIMERWHEEL
+/* The current time of the timer wheel.  When the timer wheel is used,
+ * active watchdogs are kept in the wheel rather than in g_wdactivelist.
+ */
+
+extern uint32_t g_wdnow;
+#endif
+
 /* This is the number of free, pre-allocated watchdog structures in the
  * g_wdfreelist.  This value is used to enforce a reserve for interrupt
  * handlers.
@@ -144,6 +165,16 @@ unsigned int wd_timer(int ticks);
 void wd_timer(void);
 #endif
 
+/* Timer wheel primitives (see wd_wheel.c) */
+
+#ifdef CONFIG_WDOG_TIMERWHEEL
+void wd_wheel_add(FAR struct wdog_s *wdog);
+void wd_wheel_remove(FAR struct wdog_s *wdog);
+void wd_wheel_cascade(void);
+FAR struct wdog_s *wd_wheel_expired(void);
+unsigned int wd_wheel_next(void);
+#endif
+
 #undef EXTERN
 #ifdef __cplusplus
 }
@@ -0,0 +1,140 @@
+#!/usr/bin/env python
+############################################################################
+# tools/sched_trace.py
+#
+# Copyright (c) 2015 Google, Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+# 1. Redistributions of source code must retain the above copyright notice,
+# this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright notice,
+# this list of conditions and the following disclaimer in the documentation
+# and/or other materials provided with the distribution.
+# 3. Neither the name of the copyright holder nor the names of its
+# contributors may be used to endorse or promote products derived from this
+# software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+# THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+# EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+# PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+# OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+# WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+# OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+# ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+############################################################################
+#
+# Decode a scheduler trace read from /proc/trace (CONFIG_SCHED_TRACE) into
+# a timeline, followed by the time spent in each interrupt.
+#
+#   sched_trace.py trace.bin
+#
+# The layout of the dump is described in include/nuttx/sched_trace.h.
+
+import struct
+import sys
+
+MAGIC = 0x43525453
+VERSION = 1
+
+HEADER = struct.Struct('<IBBHII')
+RECORD = struct.Struct('<IBBHI')
+
+SWITCH = 1
+IRQ_ENTER = 2
+IRQ_LEAVE = 3
+SEM_WAIT = 4
+SEM_POST = 5
+WDOG = 6
+GB_RX = 7
+GB_TX = 8
+USER = 128
+
+
+def describe(rtype, arg8, arg16, data):
+    if rtype == SWITCH:
+        return 'switch     %d -> %d (prio %d)' % (arg16, data, arg8)
+    if rtype == IRQ_ENTER:
+        return 'irq enter  %d' % arg16
+    if rtype == IRQ_LEAVE:
+        return 'irq leave  %d' % arg16
+    if rtype == SEM_WAIT:
+        return 'sem wait   pid %d on 0x%08x' % (arg16, data)
+    if rtype == SEM_POST:
+        return 'sem post   wakes pid %d on 0x%08x' % (arg16, data)
+    if rtype == WDOG:
+        return 'wdog       0x%08x (argc %d)' % (data, arg8)
+    if rtype in (GB_RX, GB_TX):
+        return 'gb %s      cport %d id %d type 0x%02x result %d' % \
+            ('rx' if rtype == GB_RX else 'tx', arg16, data & 0xffff, arg8,
+             (data >> 16) & 0xff)
+    if rtype >= USER:
+        return 'user %-5d %d %d 0x%08x' % (rtype - USER, arg8, arg16, data)
+    return 'unknown %d %d %d 0x%08x' % (rtype, arg8, arg16, data)
+
+
+def main(path):
+    with open(path, 'rb') as f:
+        blob = f.read()
+
+    if len(blob) < HEADER.size:
+        sys.exit('%s: too short for a trace header' % path)
+
+    magic, version, recsize, nrecords, lost, now = \
+        HEADER.unpack_from(blob, 0)
+    if magic != MAGIC or version != VERSION or recsize != RECORD.size:
+        sys.exit('%s: not a version %d trace' % (path, VERSION))
+
+    nrecords = min(nrecords, (len(blob) - HEADER.size) // recsize)
+    print('# %d records, %d older records lost, dumped at %.6f s' %
+          (nrecords, lost, now / 1e6))
+
+    # hrt_getusec() wraps around every 2^32 us; unwrap the timestamps so
+    # that the timeline keeps increasing.
+
+    base = 0
+    prev = None
+    irqstack = []
+    irqstats = {}
+
+    for i in range(nrecords):
+        usec, rtype, arg8, arg16, data = \
+            RECORD.unpack_from(blob, HEADER.size + i * recsize)
+        if prev is not None and usec + base < prev:
+            base += 1 << 32
+        usec += base
+        delta = usec - prev if prev is not None else 0
+        prev = usec
+
+        text = describe(rtype, arg8, arg16, data)
+
+        if rtype == IRQ_ENTER:
+            irqstack.append((arg16, usec))
+        elif rtype == IRQ_LEAVE and irqstack and irqstack[-1][0] == arg16:
+            irq, start = irqstack.pop()
+            duration = usec - start
+            text += ' (%d us)' % duration
+            count, total, worst = irqstats.get(irq, (0, 0, 0))
+            irqstats[irq] = (count + 1, total + duration,
+                             max(worst, duration))
+
+        print('%12.6f %+10d  %s' % (usec / 1e6, delta, text))
+
+    if irqstats:
+        print('\n#  IRQ   COUNT  TOTAL(us)  AVG(us)  MAX(us)')
+        for irq in sorted(irqstats):
+            count, total, worst = irqstats[irq]
+            print('# %4d %7d %10d %8d %8d' %
+                  (irq, count, total, total // count, worst))
+
+
+if __name__ == '__main__':
+    if len(sys.argv) != 2:
+        sys.exit('usage: %s <trace file>' % sys.argv[0])
+    main(sys.argv[1])